@@ -1,14 +1,28 @@
 #version 330 core
 
+// Variants as for Sample_GL.vert
+
+#if defined(FLAT)
+uniform vec3 flatColor;
+#elif defined(PALETTE)
+flat in vec3 fragColor;
+#elif !defined(WIREFRAME)
 // Interpolated values from the vertex shaders
 in vec3 fragColor;
+#endif
 
 // output data
 out vec3 color;
 
 void main()
 {
+#if defined(WIREFRAME)
+    color = WIREFRAME;
+#elif defined(FLAT)
+    color = flatColor;
+#else
     // Output color = color specified in the vertex shader,
     // interpolated between all 3 surrounding vertices of the triangle
     color = fragColor;
+#endif
 }
@@ -1,22 +1,52 @@
 #version 330 core
 
+// Built in several variants, with defines added after the version line
+// (see programs[] in Sample_GL3_3D.cpp):
+//   INSTANCED  the model matrix comes per instance, MVP holds only VP
+//   FLAT       one color for the whole draw, the flatColor uniform
+//   WIREFRAME  one color fixed at build time, the value of WIREFRAME
+//   PALETTE    face and side colors looked up by tileType; its value is
+//              the number of tile types
+// With none of the color defines the color is a vertex attribute.
+
 // input data : sent from main program
 layout (location = 0) in vec3 vertexPosition;
-layout (location = 1) in vec3 vertexColor;
+#ifdef INSTANCED
+// per instance model matrix, takes locations 2 to 5
+layout (location = 2) in mat4 instanceModel;
+#endif
 
 uniform mat4 MVP;
 
 // output data : used by fragment shader
+#if defined(PALETTE)
+// Face then side color of each tile type. The tile mesh lists its top and
+// bottom faces first, the 12 vertices that take the face color.
+uniform vec3 palette[2*PALETTE];
+uniform int tileType;
+flat out vec3 fragColor;
+#elif !defined(FLAT) && !defined(WIREFRAME)
+layout (location = 1) in vec3 vertexColor;
 out vec3 fragColor;
+#endif
 
 void main ()
 {
     vec4 v = vec4(vertexPosition, 1); // Transform an homogeneous 4D vector
 
+#if defined(PALETTE)
+    fragColor = palette[2*tileType + (gl_VertexID < 12 ? 0 : 1)];
+#elif !defined(FLAT) && !defined(WIREFRAME)
     // The color of each vertex will be interpolated
     // to produce the color of each fragment
     fragColor = vertexColor;
+#endif
 
+#ifdef INSTANCED
+    // Output position of the vertex, in clip space : VP * model * position
+    gl_Position = MVP * instanceModel * v;
+#else
     // Output position of the vertex, in clip space : MVP * position
     gl_Position = MVP * v;
+#endif
 }
@@ -1,6 +1,7 @@
 #include <iostream>
 #include <cmath>
 #include <fstream>
+#include <sstream>
 #include <vector>
 #include <string.h>
 
@@ -13,6 +14,14 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include "levelpack.h"
+#include "distfield.h"
+#include "commands.h"
+#include "audio.h"
+#include "shaders.h"
+#include "progcache.h"
+#include "startup.h"
+
 using namespace std;
 
 
@@ -21,10 +30,15 @@ struct VAO {
     GLuint VertexArrayID;
     GLuint VertexBuffer;
     GLuint ColorBuffer;
+    GLuint InstanceBuffer;
 
     GLenum PrimitiveMode;
     GLenum FillMode;
     int NumVertices;
+
+    int Program;        // the shader variant that draws it, PROG_COLOR unless set
+    glm::vec3 Color;    // for PROG_FLAT
+    int TileType;       // for the palette variants, a TILE_ value
 };
 typedef struct VAO VAO;
 
@@ -32,11 +46,8 @@ struct GLMatrices {
 	glm::mat4 projection;
 	glm::mat4 model;
 	glm::mat4 view;
-	GLuint MatrixID;
 } Matrices;
 
-GLuint programID;
-
 struct Block
 {
   VAO *block;
@@ -50,81 +61,190 @@ struct Block
 
 struct Block player;
 
-/* Function to load Shaders - Use it as it is */
-GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path) {
+const char *shaderdir = NULL;   // --shader-dir: read the shaders from here, to edit them without rebuilding
 
-	// Create the shaders
-	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
-	GLuint FragmentShaderID = glCreateShader(GL_FRAGMENT_SHADER);
+/* Source of a shader: the copy compiled in, or the file under shaderdir
+   read into buffer. NULL with a message if there is none. */
+const char *shadersource(const char *name, string &buffer)
+{
+	if(!shaderdir)
+	{
+		for(const EmbeddedShader &s : embedded_shaders)
+			if(!strcmp(s.name, name)) return s.source;
+		cerr << "No shader named " << name << " is built in" << endl;
+		return NULL;
+	}
 
-	// Read the Vertex Shader code from the file
-	std::string VertexShaderCode;
-	std::ifstream VertexShaderStream(vertex_file_path, std::ios::in);
-	if(VertexShaderStream.is_open())
+	string path = string(shaderdir) + "/" + name;
+	ifstream in(path.c_str(), ios::in | ios::binary);
+	if(!in)
 	{
-		std::string Line = "";
-		while(getline(VertexShaderStream, Line))
-			VertexShaderCode += "\n" + Line;
-		VertexShaderStream.close();
+		cerr << "Cannot read shader " << path << endl;
+		return NULL;
 	}
+	stringstream text;
+	text << in.rdbuf();
+	buffer = text.str();
+	return buffer.c_str();
+}
+
+/* Tiles the palette variants color, TILE_FLOOR to TILE_FRAGILE */
+#define PALETTE_TILES 4
+
+/* A macro's value as a string literal, for the variants' #defines */
+#define STRINGIFY(x) #x
+#define MACROSTRING(x) STRINGIFY(x)
+
+/* Face then side color of each of those tiles, uploaded once to the palette variants */
+const GLfloat tilepalette[PALETTE_TILES][2][3] = {
+	{ { 0.75, 0.75, 0.75 }, { 0.1, 0.1, 0.1 } },
+	{ { 0.8671, 0.7215, 0.5294 }, { 0.1, 0.1, 0.1 } },
+	{ { 0.4, 0.4, 0.4 }, { 0.1, 0.1, 0.1 } },
+	{ { 0.4156, 0.46666, 0.93725 }, { 0.1, 0.1, 0.1 } },
+};
+
+/* A variant of the Sample_GL.vert/.frag program. Its compile and link are
+   issued up front and checked on first use, so the driver builds it while
+   the rest of the setup runs. */
+struct ShaderProgram
+{
+	const char *name;
+	const char *defines;        // added after the #version line of both shaders
+	bool prebuild;              // started at load; the others on first use
+	GLuint id;
+	GLuint vs, fs;              // 0 for a program restored from the cache
+	unsigned long long key;
+	bool started, checked;
+	GLint matrix, color, tiletype;   // uniform locations, -1 where the variant has none
+};
+
+/* Every variant; each VAO names the cheapest that draws it. Those the game
+   draws are built at load, vertex color is only built if a VAO keeps it. */
+enum { PROG_COLOR, PROG_FLAT, PROG_WIREFRAME, PROG_PALETTE, PROG_PALETTE_INSTANCED, NPROGRAMS };
+ShaderProgram programs[NPROGRAMS] = {
+	{ "vertex color", "", 0 },
+	{ "flat", "#define FLAT\n", 1 },
+	{ "wireframe", "#define WIREFRAME vec3(0.9, 0.9, 0.9)\n", 1 },
+	{ "palette", "#define PALETTE " MACROSTRING(PALETTE_TILES) "\n", 1 },
+	{ "palette instanced", "#define PALETTE " MACROSTRING(PALETTE_TILES) "\n#define INSTANCED\n", 1 },
+};
+ShaderProgram *currentprogram = NULL;
+
+/* Print the info log of a shader or program, if the driver left one */
+void printlog(GLuint object, bool shader)
+{
+	int InfoLogLength = 0;
+	if(shader) glGetShaderiv(object, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	else glGetProgramiv(object, GL_INFO_LOG_LENGTH, &InfoLogLength);
+	if(InfoLogLength <= 1) return;
+	std::vector<char> ErrorMessage(InfoLogLength);
+	if(shader) glGetShaderInfoLog(object, InfoLogLength, NULL, &ErrorMessage[0]);
+	else glGetProgramInfoLog(object, InfoLogLength, NULL, &ErrorMessage[0]);
+	fprintf(stdout, "%s\n", &ErrorMessage[0]);
+}
+
+/* Start compiling source with defines put after its #version line, which
+   has to stay first; #line keeps the driver's messages on file lines */
+GLuint compileshader(GLenum type, const char *source, const char *defines)
+{
+	const char *rest = strchr(source, '\n');
+	rest = rest ? rest + 1 : source + strlen(source);
+	const char *parts[] = { source, defines, "#line 2\n", rest };
+	GLint lengths[] = { (GLint)(rest - source), -1, -1, -1 };
+
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 4, parts, lengths);
+	glCompileShader(shader);
+	return shader;
+}
 
-	// Read the Fragment Shader code from the file
-	std::string FragmentShaderCode;
-	std::ifstream FragmentShaderStream(fragment_file_path, std::ios::in);
-	if(FragmentShaderStream.is_open()){
-		std::string Line = "";
-		while(getline(FragmentShaderStream, Line))
-			FragmentShaderCode += "\n" + Line;
-		FragmentShaderStream.close();
+/* Issue the compile and link of a program without waiting on either - no
+   status query until finishprogram(), which is what lets them run in the
+   background. A cached binary is loaded instead when there is one. */
+void startprogram(ShaderProgram &p)
+{
+	p.id = p.vs = p.fs = 0;
+	p.started = 1;
+	p.checked = 0;
+	string VertexBuffer, FragmentBuffer;
+	char const * VertexSourcePointer = shadersource("Sample_GL.vert", VertexBuffer);
+	char const * FragmentSourcePointer = shadersource("Sample_GL.frag", FragmentBuffer);
+	if(!VertexSourcePointer or !FragmentSourcePointer) return;
+
+	// A binary saved by an earlier run skips compiling and linking
+	const char *sources[] = { VertexSourcePointer, FragmentSourcePointer, p.defines };
+	p.key = progcache_key(sources, 3);
+	p.id = progcache_load(p.key);
+	if(p.id)
+	{
+		printf("Loaded cached program : %s\n", p.name);
+		return;
 	}
 
+	printf("Compiling program : %s\n", p.name);
+	p.vs = compileshader(GL_VERTEX_SHADER, VertexSourcePointer, p.defines);
+	p.fs = compileshader(GL_FRAGMENT_SHADER, FragmentSourcePointer, p.defines);
+
+	p.id = glCreateProgram();
+	glAttachShader(p.id, p.vs);
+	glAttachShader(p.id, p.fs);
+	if(progcache_available()) glProgramParameteri(p.id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	glLinkProgram(p.id);
+}
+
+/* Wait for a started program, report how its build went, look up its
+   uniforms and load the palette; false if it did not link or never started */
+bool finishprogram(ShaderProgram &p)
+{
+	if(!p.started or p.checked) return p.id != 0;
+	p.checked = 1;
+	p.matrix = p.color = p.tiletype = -1;
+	if(!p.id) return false;
+
 	GLint Result = GL_FALSE;
-	int InfoLogLength;
-
-	// Compile Vertex Shader
-	printf("Compiling shader : %s\n", vertex_file_path);
-	char const * VertexSourcePointer = VertexShaderCode.c_str();
-	glShaderSource(VertexShaderID, 1, &VertexSourcePointer , NULL);
-	glCompileShader(VertexShaderID);
-
-	// Check Vertex Shader
-	glGetShaderiv(VertexShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(VertexShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	std::vector<char> VertexShaderErrorMessage(InfoLogLength);
-	glGetShaderInfoLog(VertexShaderID, InfoLogLength, NULL, &VertexShaderErrorMessage[0]);
-	fprintf(stdout, "%s\n", &VertexShaderErrorMessage[0]);
-
-	// Compile Fragment Shader
-	printf("Compiling shader : %s\n", fragment_file_path);
-	char const * FragmentSourcePointer = FragmentShaderCode.c_str();
-	glShaderSource(FragmentShaderID, 1, &FragmentSourcePointer , NULL);
-	glCompileShader(FragmentShaderID);
-
-	// Check Fragment Shader
-	glGetShaderiv(FragmentShaderID, GL_COMPILE_STATUS, &Result);
-	glGetShaderiv(FragmentShaderID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	std::vector<char> FragmentShaderErrorMessage(InfoLogLength);
-	glGetShaderInfoLog(FragmentShaderID, InfoLogLength, NULL, &FragmentShaderErrorMessage[0]);
-	fprintf(stdout, "%s\n", &FragmentShaderErrorMessage[0]);
-
-	// Link the program
-	fprintf(stdout, "Linking program\n");
-	GLuint ProgramID = glCreateProgram();
-	glAttachShader(ProgramID, VertexShaderID);
-	glAttachShader(ProgramID, FragmentShaderID);
-	glLinkProgram(ProgramID);
-
-	// Check the program
-	glGetProgramiv(ProgramID, GL_LINK_STATUS, &Result);
-	glGetProgramiv(ProgramID, GL_INFO_LOG_LENGTH, &InfoLogLength);
-	std::vector<char> ProgramErrorMessage( max(InfoLogLength, int(1)) );
-	glGetProgramInfoLog(ProgramID, InfoLogLength, NULL, &ProgramErrorMessage[0]);
-	fprintf(stdout, "%s\n", &ProgramErrorMessage[0]);
-
-	glDeleteShader(VertexShaderID);
-	glDeleteShader(FragmentShaderID);
-
-	return ProgramID;
+	if(p.vs)
+	{
+		printlog(p.vs, 1);
+		printlog(p.fs, 1);
+		glGetProgramiv(p.id, GL_LINK_STATUS, &Result);
+		printlog(p.id, 0);
+		if(Result == GL_TRUE) progcache_store(p.key, p.id);
+		glDetachShader(p.id, p.vs);
+		glDetachShader(p.id, p.fs);
+		glDeleteShader(p.vs);
+		glDeleteShader(p.fs);
+		p.vs = p.fs = 0;
+		if(Result != GL_TRUE)
+		{
+			fprintf(stderr, "Program %s did not link\n", p.name);
+			glDeleteProgram(p.id);
+			p.id = 0;
+			return false;
+		}
+	}
+	p.matrix = glGetUniformLocation(p.id, "MVP");
+	p.color = glGetUniformLocation(p.id, "flatColor");
+	p.tiletype = glGetUniformLocation(p.id, "tileType");
+
+	GLint palette = glGetUniformLocation(p.id, "palette");
+	if(palette >= 0)
+	{
+		glUseProgram(p.id);
+		glUniform3fv(palette, 2*PALETTE_TILES, &tilepalette[0][0][0]);
+		currentprogram = &p;
+	}
+	return true;
+}
+
+/* Make a variant current, building or checking it the first time */
+ShaderProgram &useprogram(int variant)
+{
+	ShaderProgram &p = programs[variant];
+	if(!p.started) startprogram(p);
+	finishprogram(p);
+	if(currentprogram != &p) glUseProgram(p.id);
+	currentprogram = &p;
+	return p;
 }
 
 static void error_callback(int error, const char* description)
@@ -147,6 +267,10 @@ struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloa
     vao->PrimitiveMode = primitive_mode;
     vao->NumVertices = numVertices;
     vao->FillMode = fill_mode;
+    vao->InstanceBuffer = 0;
+    vao->Program = 0;   // PROG_COLOR
+    vao->Color = glm::vec3(0, 0, 0);
+    vao->TileType = TILE_FLOOR;
 
     // Create Vertex Array Object
     // Should be done after CreateWindow and before any other GL calls
@@ -193,9 +317,61 @@ struct VAO* create3DObject (GLenum primitive_mode, int numVertices, const GLfloa
     return create3DObject(primitive_mode, numVertices, vertex_buffer_data, color_buffer_data, fill_mode);
 }
 
-/* Render the VBOs handled by VAO */
-void draw3DObject (struct VAO* vao)
+/* Generate a VAO that shares the VBOs of src and adds a per-instance model matrix */
+struct VAO* createInstanced3DObject (struct VAO* src)
 {
+    struct VAO* vao = new struct VAO;
+    *vao = *src;
+    if (vao->Program == PROG_PALETTE) vao->Program = PROG_PALETTE_INSTANCED;
+
+    glGenVertexArrays(1, &(vao->VertexArrayID));
+    glGenBuffers (1, &(vao->InstanceBuffer)); // VBO - model matrices
+
+    glBindVertexArray (vao->VertexArrayID);
+    glBindBuffer (GL_ARRAY_BUFFER, vao->VertexBuffer);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(0);
+    glBindBuffer (GL_ARRAY_BUFFER, vao->ColorBuffer);
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (void*)0);
+    glEnableVertexAttribArray(1);
+
+    // A mat4 attribute takes four vec4 slots, 2 to 5, advancing once per instance
+    glBindBuffer (GL_ARRAY_BUFFER, vao->InstanceBuffer);
+    for (int c=0; c<4; c++) {
+        glVertexAttribPointer(2+c, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(c*sizeof(glm::vec4)));
+        glEnableVertexAttribArray(2+c);
+        glVertexAttribDivisor(2+c, 1);
+    }
+
+    return vao;
+}
+
+/* Render one copy of an instanced VAO per model matrix */
+void drawInstanced3DObject (struct VAO* vao, const vector<glm::mat4> &models, const glm::mat4 &VP)
+{
+    if (models.empty()) return;
+
+    ShaderProgram &p = useprogram(vao->Program);
+    glUniformMatrix4fv(p.matrix, 1, GL_FALSE, &VP[0][0]);
+    if (p.tiletype >= 0) glUniform1i(p.tiletype, vao->TileType - TILE_FLOOR);
+
+    glPolygonMode (GL_FRONT_AND_BACK, vao->FillMode);
+    glBindVertexArray (vao->VertexArrayID);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vao->InstanceBuffer);
+    glBufferData(GL_ARRAY_BUFFER, models.size()*sizeof(glm::mat4), &models[0], GL_STREAM_DRAW);
+
+    glDrawArraysInstanced(vao->PrimitiveMode, 0, vao->NumVertices, models.size());
+}
+
+/* Render the VBOs handled by VAO with its shader variant */
+void draw3DObject (struct VAO* vao, const glm::mat4 &MVP)
+{
+    ShaderProgram &p = useprogram(vao->Program);
+    glUniformMatrix4fv(p.matrix, 1, GL_FALSE, &MVP[0][0]);
+    if (p.color >= 0) glUniform3fv(p.color, 1, &vao->Color[0]);
+    if (p.tiletype >= 0) glUniform1i(p.tiletype, vao->TileType - TILE_FLOOR);
+
     // Change the Fill Mode for this object
     glPolygonMode (GL_FRONT_AND_BACK, vao->FillMode);
 
@@ -230,18 +406,73 @@ int sx,sy,sz=1;
 short int camera=0;
 short int mcam=2;
 int levelno = 0;
+#define LEVEL_LOST -1
+vector<LevelData> levels;
+int nlevels = 0;
+State tracked;           // the block as the rules see it, for hints
+int trackedresult = MOVE_OK;
+DistanceField field;     // goal distances of the current level
+int hudmoves = -2;       // distance shown in the title bar
+bool restartpending = 0; // restart the level before the next frame
+#define RESTART_GRACE 3     // seconds to press 'N' after the block fell out of sight
+double gonetime = -1;    // when it did, -1 while the block is in play
 int moves = 0;
 bool paused = 0;
 bool muted = 0;
+int movesound = -1;      // played on every move
 float zoomfactor = 1;
 int fallx = -1, fally = -1;
 
+/* Moves left from the tracked state, -1 once the goal is out of reach */
+int movesleft ()
+{
+	if(trackedresult != MOVE_OK or levelno < 0 or levelno >= nlevels) return -1;
+	return field_distance(field, tracked);
+}
+
+/* Show the distance to the solution in the title bar, only touching it when it changes */
+void updatehud (GLFWwindow* window)
+{
+	int left = movesleft();
+	if(left == hudmoves) return;
+	hudmoves = left;
+
+	string title = "Tumblerz";
+	if(levelno >= 0 and levelno < nlevels)
+	{
+		title += " - " + levels[levelno].level.name;
+		if(left >= 0) title += " - " + to_string(left) + " moves from solution";
+		else title += " - no way to the goal from here";
+	}
+	glfwSetWindowTitle(window, title.c_str());
+}
+
+/* Print the next move of a shortest solution from where the block is */
+void showhint ()
+{
+	static const char *names[] = { "Up", "Down", "Left", "Right" };
+	char m = levelno >= 0 and levelno < nlevels and trackedresult == MOVE_OK ? field_hint(field, tracked) : 0;
+	if(!m)
+	{
+		cout << "Hint: the goal cannot be reached from here" << endl;
+		return;
+	}
+	for(int k=0; k<NUM_MOVES; k++)
+		if(board_moves[k] == m) cout << "Hint: " << names[k] << " (" << movesleft() << " moves left)" << endl;
+}
+
 void keybindings(char A)
 {
 	if(!paused)
 	{
-		if(!muted) system("aplay -q door_lock.wav &");
+		if(!muted) audio_play(movesound);
 		moves ++;
+		if(trackedresult == MOVE_OK and levelno >= 0 and levelno < nlevels)
+		{
+			trackedresult = board_step(levels[levelno].level, tracked, A, tracked);
+			if(trackedresult == MOVE_OK and field_doomed(field, tracked))
+				cout << "There is no way to the goal from here - press 'N' to restart the level\n" << endl;
+		}
 		if(A == 'U')
 		{
 			if(player.orientation == 2)
@@ -416,6 +647,12 @@ void keybindings(char A)
         		freecamera_theta = 45;
         		zoomfactor = 1;
         		break;
+        	case GLFW_KEY_H:
+        		showhint();
+        		break;
+        	case GLFW_KEY_N:
+        		restartpending = 1;
+        		break;
         	case GLFW_KEY_ESCAPE:
         		quit(window);
         		break;
@@ -533,11 +770,186 @@ short int Area[3][12][12]={
 	}
 };
 
+/* Load the levels from a pack made by levelc, or fall back to the built-in Area table */
+void loadlevels (const char *packfile)
+{
+	if(!pack_read(packfile, levels))
+	{
+		cout << "No level pack at " << packfile << ", using the built-in levels" << endl;
+		levels.assign(3, LevelData());
+		for(int l=0; l<3; l++)
+		{
+			board_init(levels[l].level, ("Level " + to_string(l+1)).c_str(), 12, 12, &Area[l][0][0]);
+			levels[l].hasmeta = false;
+			levels[l].optimal = -1;
+		}
+	}
+	nlevels = levels.size();
+}
+
+/* Tile at (i,j) of the current level, void outside the board */
+short cell (int i, int j)
+{
+	if(levelno < 0 or levelno >= nlevels) return TILE_VOID;
+	return levels[levelno].level.at(i, j);
+}
+
+/* Occupied chunks of the current level, none once the game is over */
+const vector<Chunk> &boardchunks ()
+{
+	static const vector<Chunk> none;
+	if(levelno < 0 or levelno >= nlevels) return none;
+	return levels[levelno].level.map.chunks;
+}
+
+/* Switch/bridge group of the cell at (i,j) of the current level */
+int cellgroup (int i, int j)
+{
+	if(levelno < 0 or levelno >= nlevels) return 0;
+	return levels[levelno].level.groupat(i, j);
+}
+
+/* Put the block above the start tile of the current level and start following it */
+void startposition ()
+{
+	player.x = 2.02*levels[levelno].level.startx - 10.1;
+	player.y = 2.02*levels[levelno].level.starty - 10.1;
+
+	// Levels from a pack come with their distances; solve the rest now
+	if(!levels[levelno].hasmeta) level_precompute(levels[levelno]);
+	field_build(levels[levelno], field);
+	tracked = board_start(levels[levelno].level);
+	trackedresult = MOVE_OK;
+	hudmoves = -2;
+}
+
 VAO *tile, *btile, *stile, *ftile;
-float tangle = 0;
-float ybridge = 2.02, zbridge = 0.8;
-bool mapstart = 0, bstatus = 0;
-float zswitch = -1.8;
+VAO *btiles, *stiles; // instanced bridge and switch tiles
+bool mapstart = 0;
+
+/* Bridge groups of the current level - animation state as structure of arrays, indexed by group */
+struct BridgeGroups
+{
+	int n;
+	vector<unsigned char> active;
+	vector<float> tangle, ybridge, zbridge, zswitch;
+} groups;
+
+/* Bridge and switch cells of the current level and their per-frame model matrices */
+struct GroupCells
+{
+	vector<short> x, y, g;
+	vector<glm::mat4> models;
+} bridgecells, switchcells;
+
+/* Raise every bridge and switch of the current level */
+void resetbridges ()
+{
+	groups.n = (levelno < 0 or levelno >= nlevels) ? 0 : levels[levelno].level.ngroups;
+	groups.active.assign(groups.n, 0);
+	groups.tangle.assign(groups.n, 0);
+	groups.ybridge.assign(groups.n, 2.02);
+	groups.zbridge.assign(groups.n, 0.8);
+	groups.zswitch.assign(groups.n, -1.8);
+
+	GroupCells *lists[2] = { &bridgecells, &switchcells };
+	for(int k=0; k<2; k++)
+	{
+		lists[k]->x.clear();
+		lists[k]->y.clear();
+		lists[k]->g.clear();
+	}
+	const vector<Chunk> &chunks = boardchunks();
+	for(size_t n=0; n<chunks.size(); n++)
+		for(int k=0; k<CHUNK*CHUNK; k++)
+		{
+			short v = chunks[n].tile[k];
+			GroupCells *c = v == 2 ? &bridgecells : v == 3 ? &switchcells : NULL;
+			if(!c) continue;
+			c->x.push_back(chunks[n].cx*CHUNK + k/CHUNK);
+			c->y.push_back(chunks[n].cy*CHUNK + k%CHUNK);
+			c->g.push_back(chunks[n].group[k]);
+		}
+	bridgecells.models.resize(bridgecells.x.size());
+	switchcells.models.resize(switchcells.x.size());
+}
+
+/* A cell the block falls through: void, or a bridge whose group is still up */
+bool hole (int i, int j)
+{
+	return cell(i, j) == 0 or (cell(i, j) == 2 and !groups.active[cellgroup(i, j)]);
+}
+
+/* Advance every lowering bridge group by one frame */
+void animatebridges ()
+{
+	for(int g=0; g<groups.n; g++)
+	{
+		if(groups.active[g] and fmod(groups.tangle[g],180)!=0)
+		{
+			groups.zbridge[g] -= 0.08;
+			groups.ybridge[g] -= 0.202;
+			groups.tangle[g] -= 18;
+		}
+	}
+}
+
+/* View frustum planes (a,b,c,d), inside where a*x+b*y+c*z+d >= 0 */
+struct Frustum
+{
+	float plane[6][4];
+};
+
+/* Extract the frustum planes from a view-projection matrix */
+Frustum viewfrustum (const glm::mat4 &VP)
+{
+	Frustum f;
+	for(int p=0; p<6; p++)
+	{
+		int row = p/2;
+		float sign = (p%2) ? -1 : 1;
+		for(int c=0; c<4; c++) f.plane[p][c] = VP[c][3] + sign*VP[c][row];
+	}
+	return f;
+}
+
+/* Whether any tile of the chunk, between heights zmin and zmax, can be on screen */
+bool chunkvisible (const Frustum &f, const Chunk &c, float zmin, float zmax)
+{
+	float lo[3] = { (float)(2.02*c.cx*CHUNK - 10 - 1.01), (float)(2.02*c.cy*CHUNK - 10 - 1.01), zmin };
+	float hi[3] = { (float)(2.02*(c.cx*CHUNK + CHUNK-1) - 10 + 1.01), (float)(2.02*(c.cy*CHUNK + CHUNK-1) - 10 + 1.01), zmax };
+	for(int p=0; p<6; p++)
+	{
+		// Corner of the box furthest along the plane normal
+		float d = f.plane[p][3];
+		for(int a=0; a<3; a++) d += f.plane[p][a] * (f.plane[p][a] > 0 ? hi[a] : lo[a]);
+		if(d < 0) return false;
+	}
+	return true;
+}
+
+/* Draw all bridges and all switches of the level with one instanced draw each */
+void drawbridges (glm::mat4 VP)
+{
+	vector<glm::mat4> rotate(groups.n);
+	for(int g=0; g<groups.n; g++)
+		rotate[g] = glm::rotate((float)(groups.tangle[g]*M_PI/180.0f), glm::vec3(1,0,0));
+	for(size_t b=0; b<bridgecells.x.size(); b++)
+	{
+		int g = bridgecells.g[b];
+		bridgecells.models[b] = glm::translate (glm::vec3(2.02*bridgecells.x[b]-10, 2.02*bridgecells.y[b]-10+groups.ybridge[g], -2.4-groups.zbridge[g])) * rotate[g];
+	}
+
+	glm::mat4 scaleRectangle = glm::scale (glm::vec3(0.5f, 0.5f, 0.5f));
+	for(size_t s=0; s<switchcells.x.size(); s++)
+	{
+		int g = switchcells.g[s];
+		switchcells.models[s] = glm::translate (glm::vec3(2.02*switchcells.x[s]-10, 2.02*switchcells.y[s]-10, groups.zswitch[g])) * scaleRectangle;
+	}
+
+	drawInstanced3DObject(btiles, bridgecells.models, VP);
+	drawInstanced3DObject(stiles, switchcells.models, VP);
+}
 int t=1;
 int fallfactor = 0;
 
@@ -699,6 +1111,11 @@ void createRectangle ()
   player.block = create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data1, GL_FILL);
 
   player.frame =  create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data2, GL_LINE);
+
+  // One color each: a uniform for the block, and the frame's baked into its variant
+  player.block->Program = PROG_FLAT;
+  player.block->Color = glm::vec3(0.3, 0.3, 0.3);
+  player.frame->Program = PROG_WIREFRAME;
 }
 
 void createtile()
@@ -960,6 +1377,50 @@ void createtile()
   stile = create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data3, GL_FILL);
 
   ftile = create3DObject(GL_TRIANGLES, 36, vertex_buffer_data, color_buffer_data4, GL_FILL);
+
+  // Tiles take their colors from the palette, by type
+  VAO *types[PALETTE_TILES] = { tile, btile, stile, ftile };
+  for(int k=0; k<PALETTE_TILES; k++)
+  {
+    types[k]->Program = PROG_PALETTE;
+    types[k]->TileType = TILE_FLOOR + k;
+  }
+}
+
+/* The block has dropped out of sight: the game is lost unless the player
+   restarts the level within RESTART_GRACE seconds */
+void blockgone ()
+{
+	double now = glfwGetTime();
+	if(gonetime < 0)
+	{
+		gonetime = now;
+		cout << "The block fell off the board - press 'N' within " << RESTART_GRACE << " seconds to restart the level\n" << endl;
+	}
+	else if(now - gonetime >= RESTART_GRACE) levelno = LEVEL_LOST;
+}
+
+/* Drop the block in at the start of the current level with the bridges raised */
+void restartlevel ()
+{
+	player.rangle = 0;
+	player.sangle = 0;
+	player.orientation = 0;
+	player.rx = 0;
+	player.ry = 0;
+	player.rz = 1;
+	player.z = 50;
+	if(levelno < nlevels) startposition();
+	mapstart = 0;
+	t=1;
+	fallx = fally = -1;
+	fallfactor = 0;
+	resetbridges();
+	freecamera_theta = 45;
+	freecamera_omega = 45;
+	tpcamera_theta = 0;
+	tpcamera_theta_old = 0;
+	gonetime = -1;
 }
 
 /* Render the scene with openGL */
@@ -969,10 +1430,6 @@ void draw ()
   // clear the color and depth in the frame buffer
 	glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-  // use the loaded shader program
-  // Don't change unless you know what you are doing
-	glUseProgram (programID);
-
 	if(mcam == 0 && tpcamera_theta_old - tpcamera_theta != 180) tpcamera_theta -= 18;
 	else if(mcam == 1 && tpcamera_theta -  tpcamera_theta_old != 90) tpcamera_theta += 9;
 	else if(mcam == -1 && tpcamera_theta_old - tpcamera_theta != 90) tpcamera_theta -= 9;
@@ -1017,6 +1474,8 @@ void draw ()
   	// Compute ViewProject matrix as view/camera might not be changed for this frame (basic scenario)
   	//  Don't change unless you are sure!!
 	glm::mat4 VP = Matrices.projection * Matrices.view;
+	Frustum frustum = viewfrustum(VP);
+	const vector<Chunk> &chunks = boardchunks();
 
   	// Send our transformation to the currently bound shader, in the "MVP" uniform
   	// For each model you render, since the MVP will be different (at least the M part)
@@ -1037,38 +1496,35 @@ void draw ()
 	    glm::mat4 rotateRectangle2 = glm::rotate((float)(player.sangle*M_PI/180.0f), glm::vec3(sx, sy, sz));
 	    Matrices.model *= (translateRectangle * rotateRectangle2 *rotateRectangle1);
 	    MVP = VP * Matrices.model;
-	    glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-	    // draw3DObject draws the VAO given to it using current MVP matrix
-	    draw3DObject(player.block);
-	    draw3DObject(player.frame);
+	    // draw3DObject draws the VAO given to it with the MVP matrix given
+	    draw3DObject(player.block, MVP);
+	    draw3DObject(player.frame, MVP);
 
-	    for(int i=0; i<12; i++)
+	    for(size_t c=0; c<chunks.size(); c++)
 	    {
-	    	for(int j=0; j<12; j++)
+	    	if(!chunkvisible(frustum, chunks[c], -502.8 + 5*t, -502 + 5*t)) continue;
+	    	for(int k=0; k<CHUNK*CHUNK; k++)
 	    	{
+	    		short v = chunks[c].tile[k];
+	    		int i = chunks[c].cx*CHUNK + k/CHUNK, j = chunks[c].cy*CHUNK + k%CHUNK;
 	    		Matrices.model = glm::mat4(1.0f);
-	    		if(Area[levelno][i][j]==1 or Area[levelno][i][j]==3)
+	    		if(v==1 or v==3)
 	    		{
 	          		glm::mat4 translateRectangle = glm::translate (glm::vec3(2.02*i-10, 2.02*j-10, -502.4 + 5*t));        // glTranslatef
 	          		glm::mat4 rotateRectangle = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
 	          		Matrices.model *= (translateRectangle * rotateRectangle);
 	          		MVP = VP * Matrices.model;
-	          		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-		          	// draw3DObject draws the VAO given to it using current MVP matrix
-			    	draw3DObject(tile);
+		          	// draw3DObject draws the VAO given to it with the MVP matrix given
+			    	draw3DObject(tile, MVP);
 	      		}
-	      		else if(Area[levelno][i][j]==4)
+	      		else if(v==4)
 	      		{
 	      			glm::mat4 translateRectangle = glm::translate (glm::vec3(2.02*i-10, 2.02*j-10, -502.4 + 5*t));        // glTranslatef
 	          		glm::mat4 rotateRectangle = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
 	          		Matrices.model *= (translateRectangle * rotateRectangle);
 	          		MVP = VP * Matrices.model;
-	          		glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-		          	// draw3DObject draws the VAO given to it using current MVP matrix
-			    	draw3DObject(ftile);	
+		          	// draw3DObject draws the VAO given to it with the MVP matrix given
+			    	draw3DObject(ftile, MVP);	
 	      		}
 	  		}
 		}
@@ -1077,12 +1533,7 @@ void draw ()
 	}
 	else if(mapstart == 1)
 	{
-		if (bstatus == 1 and fmod(tangle,180)!=0)
-		{
-			zbridge -= 0.08;
-			ybridge -= 0.202;
-			tangle-=18;
-		}
+		animatebridges();
 		Matrices.model = glm::mat4(1.0f);
 
 	    glm::mat4 translateRectangle = glm::translate (glm::vec3(player.x + 0.1, player.y + 0.1, player.z));        // glTranslatef
@@ -1090,11 +1541,9 @@ void draw ()
 	    glm::mat4 rotateRectangle2 = glm::rotate((float)(player.sangle*M_PI/180.0f), glm::vec3(sx, sy, sz));
 	    Matrices.model *= (translateRectangle * rotateRectangle2 *rotateRectangle1);
 	    MVP = VP * Matrices.model;
-	    glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-	    // draw3DObject draws the VAO given to it using current MVP matrix
-	    draw3DObject(player.block);
-	    draw3DObject(player.frame);
+	    // draw3DObject draws the VAO given to it with the MVP matrix given
+	    draw3DObject(player.block, MVP);
+	    draw3DObject(player.frame, MVP);
 
 	    if(fmod(player.sangle,10)!=0)
 	    {
@@ -1113,28 +1562,30 @@ void draw ()
 	    		{
 	    			int tilex = round(((player.x+0.1)+10)/2.02);
 	    			int tiley = round(((player.y+0.1)+10)/2.02);
-	    			if(Area[levelno][tilex][tiley] == 3 and bstatus!=1){
-	    				cout << "All Bridges Activated !!!\n" << endl;
-	    				zswitch -= 0.39;
-	    				bstatus = 1;
-	    				tangle -= 18;
-	    				zbridge -= 0.08;
-	    				ybridge -= 0.202;
+	    			int g = cellgroup(tilex, tiley);
+	    			if(cell(tilex, tiley) == 3 and !groups.active[g]){
+	    				if(groups.n > 1) cout << "Bridges Activated !!!\n" << endl;
+	    				else cout << "All Bridges Activated !!!\n" << endl;
+	    				groups.zswitch[g] -= 0.39;
+	    				groups.active[g] = 1;
+	    				groups.tangle[g] -= 18;
+	    				groups.zbridge[g] -= 0.08;
+	    				groups.ybridge[g] -= 0.202;
 	    			}
-	    			else if (Area[levelno][tilex][tiley]==0 or (Area[levelno][tilex][tiley]==2 and bstatus == 0))
+	    			else if (hole(tilex, tiley))
 	    			{
 	    				player.z -= 0.5;
-	    				if(player.z < -20) levelno = 4;
+	    				if(player.z < -20) blockgone();
 	    			}
-	    			else if(Area[levelno][tilex][tiley] == 4)
+	    			else if(cell(tilex, tiley) == 4)
 	    			{
 	    				player.z -= 0.5;
 	    				fallfactor -= 1;
 	    				fallx = tilex;
 	    				fally = tiley;
-	    				if(player.z < -20) levelno = 4;
+	    				if(player.z < -20) blockgone();
 	    			}
-	    			else if (Area[levelno][tilex][tiley]==5)
+	    			else if (cell(tilex, tiley)==5)
 	    			{
 	    				player.z -=0.5;
 	    				if(player.z < -10)
@@ -1142,23 +1593,10 @@ void draw ()
 	    					cout << "Level " << levelno+1;
 	    					cout << " Cleared !!!" << endl;
 	    					cout << "Total Moves Taken till now: "<< moves << endl;
+	    					if(levels[levelno].hasmeta) cout << "Best possible for this level: " << levels[levelno].optimal << " moves" << endl;
 	    					cout << "\n" <<endl;
 	    					levelno ++;
-	    					player.rangle = 0;
-  							player.sangle = 0;
-  							player.rz = 1;
-  							player.z = 50;
-  							player.x = -2.02*4;
-  							player.y = -2.02*4;
-  							mapstart = 0;
-  							t=1;
-  							zswitch = -1.8;
-  							bstatus = 0;
-  							ybridge = 2.02, zbridge = 0.8;
-  							freecamera_theta = 45;
-  							freecamera_omega = 45;
-  							tpcamera_theta = 0;
-  							tpcamera_theta_old = 0;
+	    					restartlevel();
 	    				}
 	    			}
 	    		}
@@ -1168,14 +1606,14 @@ void draw ()
 	    			int yc1 = round((((player.y+0.1)+10)-1.01)/2.02);
 	    			int yc2 = round((((player.y+0.1)+10)+1.01)/2.02);
 
-	    			if((Area[levelno][xc][yc1] == 0 or (Area[levelno][xc][yc1]==2 and bstatus == 0)) and (Area[levelno][xc][yc2] == 0 or (Area[levelno][xc][yc2]==2 and bstatus == 0)))
+	    			if(hole(xc, yc1) and hole(xc, yc2))
 	    			{
-	    				if(player.z < -20) levelno = 4;
+	    				if(player.z < -20) blockgone();
 	    				player.z -= 0.5;
 	    			}
-	    			else if(Area[levelno][xc][yc1] == 0 or (Area[levelno][xc][yc1]==2 and bstatus == 0)) 
+	    			else if(hole(xc, yc1)) 
 	    			{
-	    				if(player.z < -20) levelno = 4;
+	    				if(player.z < -20) blockgone();
 	    				player.y += 0.101;
 	    				player.z -= 0.5;
 	    				player.rx = 1;
@@ -1183,9 +1621,9 @@ void draw ()
 	    				player.ry = 0;
 	    				player.rangle += 9;
 	    			} 
-	    			else if(Area[levelno][xc][yc2] == 0 or (Area[levelno][xc][yc2]==2 and bstatus == 0))
+	    			else if(hole(xc, yc2))
 	    			{
-	    				if(player.z < -20) levelno = 4;
+	    				if(player.z < -20) blockgone();
 	    				player.y -= 0.101;
 	    				player.z -= 0.5;
 	    				player.rx = -1;
@@ -1200,14 +1638,14 @@ void draw ()
 	    			int xc2 = round((((player.x+0.1)+10)+1.01)/2.02);    
 	    			int yc = round(((player.y+0.1)+10)/2.02);
 
-    				if((Area[levelno][xc1][yc] == 0 or (Area[levelno][xc1][yc]==2 and bstatus == 0)) and (Area[levelno][xc2][yc] == 0 or (Area[levelno][xc2][yc]==2 and bstatus == 0)))
+    				if(hole(xc1, yc) and hole(xc2, yc))
     				{
-    					if(player.z < -20) levelno = 4;
+    					if(player.z < -20) blockgone();
     					player.z -= 0.5;
     				}
-    				else if(Area[levelno][xc2][yc] == 0 or (Area[levelno][xc2][yc]==2 and bstatus == 0))
+    				else if(hole(xc2, yc))
     				{
-    					if(player.z < -20) levelno = 4;
+    					if(player.z < -20) blockgone();
     					player.rx = 0;
     					player.rz = 0;
     					player.ry = 1;
@@ -1215,9 +1653,9 @@ void draw ()
     					player.x -= 0.101;
     					player.z -= 0.5;
     				}
-    				else if(Area[levelno][xc1][yc] == 0 or (Area[levelno][xc1][yc]==2 and bstatus == 0))
+    				else if(hole(xc1, yc))
     				{
-    					if(player.z < -20) levelno = 4;
+    					if(player.z < -20) blockgone();
     					player.rx = 0;
     					player.rz = 0;
     					player.ry = -1;
@@ -1290,34 +1728,27 @@ void draw ()
 
 	    	}
 	    }
-	    for(int i=0; i<12; i++)
+	    // The level may have just changed under us
+	    const vector<Chunk> &board = boardchunks();
+	    for(size_t c=0; c<board.size(); c++)
 	    {
-	    	for(int j=0; j<12; j++)
+	    	// A falling fragile tile is only followed while its chunk is in view
+	    	if(!chunkvisible(frustum, board[c], -3.5, -1)) continue;
+	    	for(int k=0; k<CHUNK*CHUNK; k++)
 	    	{
+	    		short v = board[c].tile[k];
+	    		int i = board[c].cx*CHUNK + k/CHUNK, j = board[c].cy*CHUNK + k%CHUNK;
 	    		Matrices.model = glm::mat4(1.0f);
-	    		if(Area[levelno][i][j]==1 or Area[levelno][i][j]==3)
+	    		if(v==1 or v==3)
 	    		{
 	        		translateRectangle = glm::translate (glm::vec3(2.02*i-10, 2.02*j-10, -2.4));        // glTranslatef
         			glm::mat4 rotateRectangle = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
           			Matrices.model *= (translateRectangle * rotateRectangle);
           			MVP = VP * Matrices.model;
-          			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-		          // draw3DObject draws the VAO given to it using current MVP matrix
-		          draw3DObject(tile);
+		          // draw3DObject draws the VAO given to it with the MVP matrix given
+		          draw3DObject(tile, MVP);
 		      	}
-		      	else if(Area[levelno][i][j]==2)
-		      	{
-		        	translateRectangle = glm::translate (glm::vec3(2.02*i-10, 2.02*j-10+ybridge, -2.4-zbridge));        // glTranslatef
-		        	glm::mat4 rotateRectangle = glm::rotate((float)(tangle*M_PI/180.0f), glm::vec3(1,0,0)); // rotate about vector (-1,1,1)
-		        	Matrices.model *= (translateRectangle * rotateRectangle);
-		        	MVP = VP * Matrices.model;
-        			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-		        	// draw3DObject draws the VAO given to it using current MVP matrix
-          			draw3DObject(btile); 
-      			}
-      			else if(Area[levelno][i][j] == 4)
+      			else if(v == 4)
 	      		{
 	      			if(i == fallx and j == fally)
 	      			{
@@ -1325,10 +1756,8 @@ void draw ()
 	      				glm::mat4 rotateRectangle = glm::rotate((float)(sin(2*fallfactor*M_PI/180.0f)), glm::vec3(1,1,0)); // rotate about vector (-1,1,1)
 	          			Matrices.model *= (translateRectangle * rotateRectangle);
 	          			MVP = VP * Matrices.model;
-	          			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-		          		// draw3DObject draws the VAO given to it using current MVP matrix
-			    		draw3DObject(ftile);
+		          		// draw3DObject draws the VAO given to it with the MVP matrix given
+			    		draw3DObject(ftile, MVP);
 	      			}
 	      			else
 	      			{
@@ -1336,27 +1765,15 @@ void draw ()
 	      				glm::mat4 rotateRectangle = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
 	          			Matrices.model *= (translateRectangle * rotateRectangle);
 	          			MVP = VP * Matrices.model;
-	          			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-		          		// draw3DObject draws the VAO given to it using current MVP matrix
-			    		draw3DObject(ftile);
+		          		// draw3DObject draws the VAO given to it with the MVP matrix given
+			    		draw3DObject(ftile, MVP);
 			    	}	
 	      		}
-      			if(Area[levelno][i][j]==3)
-      			{
-      				Matrices.model = glm::mat4(1.0f);
-        			translateRectangle = glm::translate (glm::vec3(2.02*i-10, 2.02*j-10, zswitch));        // glTranslatef
-          			glm::mat4 rotateRectangle = glm::rotate((float)(rectangle_rotation*M_PI/180.0f), glm::vec3(0,0,1)); // rotate about vector (-1,1,1)
-          			glm::mat4 scaleRectangle = glm::scale (glm::vec3(0.5f, 0.5f, 0.5f));
-          			Matrices.model *= (translateRectangle * rotateRectangle * scaleRectangle);
-          			MVP = VP * Matrices.model;
-        			glUniformMatrix4fv(Matrices.MatrixID, 1, GL_FALSE, &MVP[0][0]);
-
-		        	// draw3DObject draws the VAO given to it using current MVP matrix
-        			draw3DObject(stile);
-    			}
   			}
 		}
+
+		// Bridges and switches go in one instanced draw each, however many there are
+		drawbridges(VP);
 	}
 }
 /* Initialise glfw window, I/O callbacks and the renderer to use */
@@ -1369,6 +1786,7 @@ GLFWwindow* initGLFW (int width, int height)
     if (!glfwInit()) {
 //        exit(EXIT_FAILURE);
     }
+    startup_mark("glfw_init");
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -1384,7 +1802,9 @@ GLFWwindow* initGLFW (int width, int height)
     }
 
     glfwMakeContextCurrent(window);
+    startup_mark("create_window");
     gladLoadGLLoader((GLADloadproc) glfwGetProcAddress);
+    startup_mark("glad_load");
     glfwSwapInterval( 1 );
 
     /* --- register callbacks with GLFW --- */
@@ -1423,15 +1843,18 @@ void initGL (GLFWwindow* window, int width, int height)
 	glDepthFunc (GL_LEQUAL);
   	glEnable(GL_MULTISAMPLE);
 
+	// Start building the GLSL programs first; the meshes are made while the
+	// driver compiles and links, and draw() checks them on first use
+	if(GLAD_GL_ARB_parallel_shader_compile) glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+	for(int k=0; k<NPROGRAMS; k++)
+		if(programs[k].prebuild) startprogram(programs[k]);
+	startup_mark("shaders_start");
+
   	createRectangle ();
   	createtile();
-	
-	// Create and compile our GLSL program from the shaders
-	programID = LoadShaders( "Sample_GL.vert", "Sample_GL.frag" );
-	// Get a handle for our "MVP" uniform
-	Matrices.MatrixID = glGetUniformLocation(programID, "MVP");
+  	btiles = createInstanced3DObject(btile);
+  	stiles = createInstanced3DObject(stile);
 
-	
 	reshapeWindow (window, width, height);
 
 
@@ -1439,24 +1862,78 @@ void initGL (GLFWwindow* window, int width, int height)
     cout << "RENDERER: " << glGetString(GL_RENDERER) << endl;
     cout << "VERSION: " << glGetString(GL_VERSION) << endl;
     cout << "GLSL: " << glGetString(GL_SHADING_LANGUAGE_VERSION) << endl;
+	startup_mark("meshes");
 }
 
 int main (int argc, char** argv)
 {
 	int width = 800;
 	int height = 800;
+	const char *packfile = "levels.pack";
+	const char *solve = NULL;
+	const char *validate = NULL;
+	const char *format = "csv";
+	int farm = 0;
+	int jobtimeout = 60;
+	const char *audio = "auto";
+	const char *audiobench = NULL;
+	bool mixbench = 0;
+	bool startupreport = 0;
+	SolveOptions opt;
+	opt.algo = "bfs";
+	opt.nthreads = 0;
+	opt.tmpdir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+	opt.memory = 256 << 20;
+
+	for(int a=1; a<argc; a++)
+	{
+		if(!strcmp(argv[a], "--pack") and a+1 < argc) packfile = argv[++a];
+		else if(!strcmp(argv[a], "--solve") and a+1 < argc) solve = argv[++a];
+		else if(!strcmp(argv[a], "--threads") and a+1 < argc) opt.nthreads = atoi(argv[++a]);
+		else if(!strcmp(argv[a], "--algo") and a+1 < argc) opt.algo = argv[++a];
+		else if(!strcmp(argv[a], "--tmpdir") and a+1 < argc) opt.tmpdir = argv[++a];
+		else if(!strcmp(argv[a], "--mem") and a+1 < argc) opt.memory = (size_t)atoi(argv[++a]) << 20;
+		else if(!strcmp(argv[a], "--validate-pack") and a+1 < argc) validate = argv[++a];
+		else if(!strcmp(argv[a], "--format") and a+1 < argc) format = argv[++a];
+		else if(!strcmp(argv[a], "--farm") and a+1 < argc) farm = atoi(argv[++a]);
+		else if(!strcmp(argv[a], "--job-timeout") and a+1 < argc) jobtimeout = atoi(argv[++a]);
+		else if(!strcmp(argv[a], "--audio") and a+1 < argc) audio = argv[++a];
+		else if(!strcmp(argv[a], "--audio-bench") and a+1 < argc) audiobench = argv[++a];
+		else if(!strcmp(argv[a], "--mix-bench")) mixbench = 1;
+		else if(!strcmp(argv[a], "--shader-dir") and a+1 < argc) shaderdir = argv[++a];
+		else if(!strcmp(argv[a], "--startup-report")) startupreport = 1;
+	}
+
+	// Headless modes - no window needed
+	if(validate) return command_validate(validate, format, opt.nthreads, farm, jobtimeout, opt.tmpdir);
+	if(audiobench) return command_audiobench(audiobench, "door_lock.wav");
+	if(mixbench) return command_mixbench();
+	loadlevels(packfile);
+	startup_mark("load_levels");
+	if(solve) return command_solve(levels, solve, opt);
+
+    GLFWwindow* window = initGLFW(width, height);
+
+	initGL (window, width, height);
+
+	// Level and sound setup overlap the shader builds initGL left running
   	player.rangle = 0;
   	player.sangle = 0;
   	player.rz = 1;
   	player.z = 50;
-  	player.x = -2.02*4;
-  	player.y = -2.02*4;
+  	startposition();
+  	resetbridges();
   	moves = 0; 
+	startup_mark("level_setup");
 
+	movesound = audio_load("door_lock.wav");
+	if(movesound >= 0) audio_init(audio_backend(audio));
+	startup_mark("audio_init");
 
-    GLFWwindow* window = initGLFW(width, height);
-
-	initGL (window, width, height);
+	// The first frame needs the programs; wait for them here so the report
+	// tells the shader build apart from the drawing
+	for(int k=0; k<NPROGRAMS; k++) finishprogram(programs[k]);
+	startup_mark("shaders_finish");
 
     double last_update_time = glfwGetTime(), current_time;
 
@@ -1474,27 +1951,46 @@ int main (int argc, char** argv)
     cout << "Press 'R' to reset the camera angle and position" << endl;
     cout << "Use 'P' to pause the game" << endl;
     cout << "Press 'M' to mute or unmute audio." << endl;
+    cout << "Press 'H' for a hint, the title bar shows how far you are from a solution." << endl;
+    cout << "Press 'N' to restart the level." << endl;
 
     /* Draw in loop */
-    while (!glfwWindowShouldClose(window) and levelno<3) {
+    while (!glfwWindowShouldClose(window) and levelno>=0 and levelno<nlevels) {
+
+        if(restartpending)
+        {
+        	cout << "Restarting level " << levelno+1 << "\n" << endl;
+        	restartlevel();
+        	restartpending = 0;
+        }
 
         // OpenGL Draw commands
         draw();
+        updatehud(window);
 
-        if(levelno == 3)
+        if(levelno == nlevels)
         {
         	cout << "YOU WON THE GAME !!! " << endl;
         	quit(window);
         }
-        else if(levelno == 4)
+        else if(levelno == LEVEL_LOST)
         {
         	cout << "GAME OVER ! :( YOU LOST :( \n" << endl;
         	quit(window);
         }
 
+        if(startupreport) startup_mark("first_draw");
+
         // Swap Frame Buffer in double buffering
         glfwSwapBuffers(window);
 
+        if(startupreport)
+        {
+        	startup_mark("first_swap");
+        	startup_report(format);
+        	startupreport = 0;
+        }
+
         // Poll for Keyboard and mouse events
         glfwPollEvents();
 
@@ -1506,6 +2002,7 @@ int main (int argc, char** argv)
         }
     }
 
+    audio_shutdown();
     glfwTerminate();
 //    exit(EXIT_SUCCESS);
 }
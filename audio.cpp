@@ -0,0 +1,300 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "audio.h"
+#include "mixer.h"
+#include "wav.h"
+
+using namespace std;
+
+/* A loaded sound: interleaved stereo samples, straight from the mapped
+   file when it is already in the mixer format, else converted once */
+struct Sound
+{
+    WavFile file;
+    vector<short> converted;
+    const short *samples;
+    size_t count;   // samples, not frames
+};
+
+/* A slot of the voice pool: the sound it plays and how far in it is */
+struct Voice
+{
+    int sound;            // -1 when the slot is free
+    unsigned long long pos;      // 16.16 fixed point frame
+    unsigned int step;           // MIX_STEP_ONE plays at the recorded pitch
+    int gain;                    // Q14, MIX_UNITY is unchanged
+    unsigned long long serial;   // start order, the smallest is stolen first
+};
+
+/* A request from the game thread to the audio thread */
+struct AudioCommand
+{
+    int sound;
+    int gain;
+    unsigned int step;
+    long long when;   // steady clock ns at the trigger
+};
+
+/* Single producer, single consumer ring: the game thread only moves tail,
+   the audio thread only moves head */
+struct CommandQueue
+{
+    AudioCommand ring[AUDIO_COMMANDS];
+    atomic<unsigned int> head, tail;
+
+    bool push (const AudioCommand &c)
+    {
+        unsigned int t = tail.load(memory_order_relaxed);
+        if (t - head.load(memory_order_acquire) == AUDIO_COMMANDS) return false;
+        ring[t % AUDIO_COMMANDS] = c;
+        tail.store(t + 1, memory_order_release);
+        return true;
+    }
+
+    bool pop (AudioCommand &c)
+    {
+        unsigned int h = head.load(memory_order_relaxed);
+        if (h == tail.load(memory_order_acquire)) return false;
+        c = ring[h % AUDIO_COMMANDS];
+        head.store(h + 1, memory_order_release);
+        return true;
+    }
+};
+
+static vector<Sound *> sounds;
+static unordered_map<string, int> loaded;   // sound id by canonical path
+static CommandQueue queue;
+static atomic<bool> running(false);
+static thread mixer;
+static AudioBackend *output = NULL;
+static AudioStats stats;
+
+static long long nowns ()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/* Bring stereo samples at rate to AUDIO_RATE with the mixer's resampler,
+   the same one that changes pitch while playing */
+static void resample (const vector<short> &in, unsigned int rate, vector<short> &out)
+{
+    unsigned int step = (unsigned int)(((unsigned long long)rate * MIX_STEP_ONE + AUDIO_RATE/2) / AUDIO_RATE);
+    size_t frames = in.size() / AUDIO_CHANNELS;
+    if (step == MIX_STEP_ONE || frames < 2)
+    {
+        out = in;
+        return;
+    }
+
+    // Interpolation needs the frame after each position read
+    unsigned long long last = (unsigned long long)(frames - 1) << 16, pos = 0;
+    out.resize((last + step - 1) / step * AUDIO_CHANNELS);
+    const MixKernels &kern = mix_kernels();
+    int acc[AUDIO_PERIOD * AUDIO_CHANNELS];
+    for (size_t i=0; i<out.size(); i += AUDIO_PERIOD * AUDIO_CHANNELS)
+    {
+        size_t n = min((size_t)AUDIO_PERIOD, (out.size() - i) / AUDIO_CHANNELS);
+        memset(acc, 0, sizeof(acc));
+        kern.addresampled(acc, in.data() + (pos >> 16) * AUDIO_CHANNELS, pos & 0xffff, step, n, MIX_UNITY);
+        kern.clamp(out.data() + i, acc, n * AUDIO_CHANNELS);
+        pos += (unsigned long long)n * step;
+    }
+}
+
+int audio_load (const char *path)
+{
+    char *real = realpath(path, NULL);
+    string key = real ? real : path;
+    free(real);
+    unordered_map<string, int>::iterator it = loaded.find(key);
+    if (it != loaded.end()) return it->second;
+
+    Sound *s = new Sound();
+    if (!wav_open(path, s->file))
+    {
+        delete s;
+        return -1;
+    }
+    // A period of resampling steps must fit the kernel's 32-bit position
+    if (s->file.rate > AUDIO_RATE * 64)
+    {
+        fprintf(stderr, "%s: sample rate %u is too high\n", path, s->file.rate);
+        wav_close(s->file);
+        delete s;
+        return -1;
+    }
+    if (wav_native(s->file, AUDIO_RATE, AUDIO_CHANNELS))
+    {
+        s->samples = (const short *)s->file.data;
+        s->count = s->file.frames * AUDIO_CHANNELS;
+    }
+    else
+    {
+        vector<short> samples(s->file.frames * AUDIO_CHANNELS);
+        wav_convert(s->file, AUDIO_CHANNELS, samples.data());
+        resample(samples, s->file.rate, s->converted);
+        wav_close(s->file);
+        s->samples = s->converted.data();
+        s->count = s->converted.size();
+    }
+
+    sounds.push_back(s);
+    return loaded[key] = sounds.size() - 1;
+}
+
+/* Take a free voice for c, or the oldest one if all are playing */
+static void startvoice (Voice *pool, const AudioCommand &c, unsigned long long serial)
+{
+    Voice *v = pool;
+    for (int k=0; k<AUDIO_VOICES; k++)
+    {
+        if (pool[k].sound < 0)
+        {
+            v = &pool[k];
+            break;
+        }
+        if (pool[k].serial < v->serial) v = &pool[k];
+    }
+    if (v->sound >= 0) stats.stolen++;
+    v->sound = c.sound;
+    v->pos = 0;
+    v->step = c.step;
+    v->gain = c.gain;
+    v->serial = serial;
+}
+
+/* Sum the playing voices into one period, freeing those that finished */
+static void mix (const MixKernels &kern, Voice *pool, short *out)
+{
+    int acc[AUDIO_PERIOD * AUDIO_CHANNELS] = { 0 };
+    for (int k=0; k<AUDIO_VOICES; k++)
+    {
+        Voice &v = pool[k];
+        if (v.sound < 0) continue;
+        const Sound &s = *sounds[v.sound];
+        size_t frames = s.count / AUDIO_CHANNELS, at = v.pos >> 16, n;
+        if (frames < 2)
+        {
+            // Too short to interpolate, and silent anyway
+            v.sound = -1;
+            continue;
+        }
+        if (v.step == MIX_STEP_ONE && !(v.pos & 0xffff))
+        {
+            n = min(frames - at, (size_t)AUDIO_PERIOD);
+            kern.add(acc, s.samples + at*AUDIO_CHANNELS, n * AUDIO_CHANNELS, v.gain);
+            v.pos += (unsigned long long)n << 16;
+            if (at + n >= frames) v.sound = -1;
+        }
+        else
+        {
+            // Interpolation needs the frame after each position read
+            unsigned long long last = (unsigned long long)(frames - 1) << 16;
+            n = v.pos < last ? min((size_t)AUDIO_PERIOD, (size_t)((last - v.pos + v.step - 1) / v.step)) : 0;
+            kern.addresampled(acc, s.samples + at*AUDIO_CHANNELS, v.pos & 0xffff, v.step, n, v.gain);
+            v.pos += (unsigned long long)n * v.step;
+            if (n < AUDIO_PERIOD) v.sound = -1;
+        }
+    }
+    kern.clamp(out, acc, AUDIO_PERIOD * AUDIO_CHANNELS);
+}
+
+/* The audio thread: one period at a time, paced by the backend. Everything
+   it needs is preallocated here, so a period costs at most AUDIO_VOICES
+   voices and AUDIO_COMMANDS commands whatever the game thread does. */
+static void audioloop ()
+{
+    const MixKernels &kern = mix_kernels();
+    Voice pool[AUDIO_VOICES];
+    for (int k=0; k<AUDIO_VOICES; k++) pool[k].sound = -1;
+    unsigned long long serial = 0;
+    short out[AUDIO_PERIOD * AUDIO_CHANNELS];
+    AudioCommand fresh[AUDIO_COMMANDS];
+    size_t frame = 0;
+    while (running.load(memory_order_relaxed))
+    {
+        int nfresh = 0;
+        while (nfresh < AUDIO_COMMANDS && queue.pop(fresh[nfresh]))
+        {
+            startvoice(pool, fresh[nfresh], serial++);
+            nfresh++;
+        }
+
+        long long t0 = nowns();
+        mix(kern, pool, out);
+        stats.mixms += (nowns() - t0) / 1e6;
+        stats.periods++;
+
+        if (!output->write(out, AUDIO_PERIOD))
+        {
+            fprintf(stderr, "Audio output failed, sound disabled\n");
+            running = false;
+            return;
+        }
+
+        // Latency runs until the backend has taken the first samples
+        long long now = nowns();
+        for (int k=0; k<nfresh; k++)
+        {
+            double ms = (now - fresh[k].when) / 1e6;
+            output->started(frame, ms);
+            stats.started++;
+            stats.latencyms += ms;
+            if (ms > stats.maxlatencyms) stats.maxlatencyms = ms;
+        }
+        frame += AUDIO_PERIOD;
+    }
+}
+
+bool audio_init (AudioBackend *backend)
+{
+    stats = AudioStats();
+    output = backend;
+    if (!output || !output->open())
+    {
+        fprintf(stderr, "Cannot open audio output, sound disabled\n");
+        if (output) output->close();
+        delete output;
+        output = NULL;
+        return false;
+    }
+
+    mix_kernels();   // pick the kernels before the audio thread needs them
+    running = true;
+    mixer = thread(audioloop);
+    return true;
+}
+
+void audio_play (int sound, float gain, float pitch)
+{
+    if (sound < 0 || sound >= (int)sounds.size() || !running.load(memory_order_relaxed)) return;
+    gain = gain < 0 ? 0 : gain > 1.99f ? 1.99f : gain;
+    pitch = pitch < 1/16.0f ? 1/16.0f : pitch > 16 ? 16 : pitch;
+    AudioCommand c = { sound, (int)(gain * MIX_UNITY + 0.5f), (unsigned int)(pitch * MIX_STEP_ONE + 0.5f), nowns() };
+    queue.push(c);
+}
+
+void audio_shutdown ()
+{
+    running = false;
+    if (mixer.joinable()) mixer.join();
+    if (output)
+    {
+        output->close();
+        delete output;
+    }
+    output = NULL;
+}
+
+AudioStats audio_stats ()
+{
+    return stats;
+}
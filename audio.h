@@ -0,0 +1,80 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <stddef.h>
+
+/* In-process sound effects. Sounds are decoded once, mixed on a dedicated
+   audio thread and handed to an AudioBackend. The game thread only pushes
+   commands onto a lock-free queue, so triggering a sound never blocks,
+   allocates or starts a process. */
+
+#define AUDIO_RATE 44100
+#define AUDIO_CHANNELS 2
+#define AUDIO_PERIOD 512     // frames mixed per pass, about 12 ms
+#define AUDIO_COMMANDS 64    // commands the queue holds before play requests are dropped
+#define AUDIO_VOICES 16      // sounds playing at once; a new one replaces the oldest
+
+/* Where the mixed audio goes. write() takes one period of interleaved
+   frames and should block for as long as the output needs to keep pace. */
+struct AudioBackend
+{
+    virtual ~AudioBackend () {}
+    virtual bool open () = 0;
+    virtual bool write (const short *frames, int n) = 0;
+    virtual void close () = 0;
+
+    /* A sound triggered latency_ms earlier starts at output frame frame */
+    virtual void started (size_t frame, double latency_ms) {}
+};
+
+/* The default ALSA device; NULL when built without ALSA */
+AudioBackend *audio_alsa ();
+
+/* An aplay process fed raw PCM through a pipe */
+AudioBackend *audio_aplay ();
+
+/* Discards the audio, in real time if paced so latency can be measured */
+AudioBackend *audio_null (bool paced);
+
+/* Writes the mixed output to a WAV file in real time, and the frame, time
+   and latency of every sound start to path.csv */
+AudioBackend *audio_wavfile (const char *path);
+
+/* Backend by name: "alsa", "aplay", "null" or "wav:<file>"; "auto" is
+   ALSA when available, else aplay. NULL if the name is unknown or the
+   backend is not built in. */
+AudioBackend *audio_backend (const char *name);
+
+/* What the audio thread has done so far */
+struct AudioStats
+{
+    size_t periods;        // periods mixed
+    double mixms;          // CPU time spent mixing them
+    size_t started;        // sounds started
+    size_t stolen;         // sounds cut short to free a voice
+    double latencyms;      // summed trigger-to-output latency of those
+    double maxlatencyms;
+};
+
+/* Load a WAV file (see wav_open()). A file already in the mixer format is
+   played from its memory mapping, others are converted once; loading the
+   same file again returns the same id. Returns the sound id, or -1 with a
+   message on stderr. Sounds must be loaded before audio_init(). */
+int audio_load (const char *path);
+
+/* Start the audio thread on backend, which audio_shutdown() deletes.
+   Returns false if the backend does not open, in which case audio_play()
+   does nothing. */
+bool audio_init (AudioBackend *backend);
+
+/* Start playing a sound at gain (up to about 2) and pitch (1/16 to 16, 1
+   is as recorded); safe to call from the game thread at any rate */
+void audio_play (int sound, float gain = 1, float pitch = 1);
+
+/* Stop the audio thread and close the output */
+void audio_shutdown ();
+
+/* Statistics of the last run, complete once audio_shutdown() returned */
+AudioStats audio_stats ();
+
+#endif
@@ -0,0 +1,236 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <thread>
+
+#ifdef HAVE_ALSA
+#include <alsa/asoundlib.h>
+#endif
+
+#include "audio.h"
+
+using namespace std;
+
+#ifdef HAVE_ALSA
+struct AlsaBackend : AudioBackend
+{
+    snd_pcm_t *pcm;
+
+    AlsaBackend () : pcm(NULL) {}
+
+    bool open ()
+    {
+        int err = snd_pcm_open(&pcm, "default", SND_PCM_STREAM_PLAYBACK, 0);
+        if (err == 0)
+            err = snd_pcm_set_params(pcm, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED,
+                                     AUDIO_CHANNELS, AUDIO_RATE, 1, 30000);   // 30 ms of buffering
+        if (err < 0) fprintf(stderr, "ALSA: %s\n", snd_strerror(err));
+        return err == 0;
+    }
+
+    bool write (const short *frames, int n)
+    {
+        while (n > 0)
+        {
+            snd_pcm_sframes_t w = snd_pcm_writei(pcm, frames, n);
+            if (w < 0) w = snd_pcm_recover(pcm, w, 1);   // underruns happen, carry on
+            if (w < 0)
+            {
+                fprintf(stderr, "ALSA: %s\n", snd_strerror(w));
+                return false;
+            }
+            frames += w * AUDIO_CHANNELS;
+            n -= w;
+        }
+        return true;
+    }
+
+    void close ()
+    {
+        if (!pcm) return;
+        snd_pcm_drain(pcm);
+        snd_pcm_close(pcm);
+        pcm = NULL;
+    }
+};
+
+AudioBackend *audio_alsa () { return new AlsaBackend(); }
+#else
+AudioBackend *audio_alsa () { return NULL; }
+#endif
+
+struct AplayBackend : AudioBackend
+{
+    FILE *pipe;
+
+    AplayBackend () : pipe(NULL) {}
+
+    bool open ()
+    {
+        // A short buffer keeps key presses responsive
+        char cmd[128];
+        snprintf(cmd, sizeof(cmd), "aplay -q -t raw -f S16_LE -c %d -r %d -B 40000 2>/dev/null", AUDIO_CHANNELS, AUDIO_RATE);
+        signal(SIGPIPE, SIG_IGN);   // a missing aplay shows up as a failed write instead
+        pipe = popen(cmd, "w");
+        if (!pipe) return false;
+        fcntl(fileno(pipe), F_SETPIPE_SZ, AUDIO_PERIOD * AUDIO_CHANNELS * 2);
+        return true;
+    }
+
+    bool write (const short *frames, int n)
+    {
+        const char *p = (const char *)frames;
+        size_t left = n * AUDIO_CHANNELS * sizeof(short);
+        while (left > 0)
+        {
+            ssize_t w = ::write(fileno(pipe), p, left);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) return false;
+            p += w;
+            left -= w;
+        }
+        return true;
+    }
+
+    void close ()
+    {
+        if (pipe) pclose(pipe);
+        pipe = NULL;
+    }
+};
+
+AudioBackend *audio_aplay () { return new AplayBackend(); }
+
+/* Blocks writes the way a device would: each returns once the previous
+   period has played */
+struct Pacer
+{
+    chrono::steady_clock::time_point due;
+
+    void start () { due = chrono::steady_clock::now(); }
+
+    void wait (int n)
+    {
+        this_thread::sleep_until(due);
+        due += chrono::microseconds((long long)n * 1000000 / AUDIO_RATE);
+    }
+};
+
+struct NullBackend : AudioBackend
+{
+    bool paced;
+    Pacer pacer;
+
+    NullBackend (bool p) : paced(p) {}
+
+    bool open ()
+    {
+        pacer.start();
+        return true;
+    }
+
+    bool write (const short *frames, int n)
+    {
+        if (paced) pacer.wait(n);
+        return true;
+    }
+
+    void close () {}
+};
+
+AudioBackend *audio_null (bool paced) { return new NullBackend(paced); }
+
+struct WavBackend : AudioBackend
+{
+    string path;
+    FILE *wav, *cues;
+    size_t frames;
+    Pacer pacer;
+
+    WavBackend (const char *p) : path(p), wav(NULL), cues(NULL), frames(0) {}
+
+    static void put16 (unsigned char *p, unsigned int v) { p[0] = v; p[1] = v >> 8; }
+    static void put32 (unsigned char *p, unsigned int v) { put16(p, v); put16(p + 2, v >> 16); }
+
+    /* The canonical 44 byte header for the frames written so far */
+    void header ()
+    {
+        unsigned char h[44];
+        unsigned int bytes = frames * AUDIO_CHANNELS * 2;
+        memcpy(h, "RIFF", 4);
+        put32(h + 4, 36 + bytes);
+        memcpy(h + 8, "WAVEfmt ", 8);
+        put32(h + 16, 16);
+        put16(h + 20, 1);
+        put16(h + 22, AUDIO_CHANNELS);
+        put32(h + 24, AUDIO_RATE);
+        put32(h + 28, AUDIO_RATE * AUDIO_CHANNELS * 2);
+        put16(h + 32, AUDIO_CHANNELS * 2);
+        put16(h + 34, 16);
+        memcpy(h + 36, "data", 4);
+        put32(h + 40, bytes);
+        fseek(wav, 0, SEEK_SET);
+        fwrite(h, 1, sizeof(h), wav);
+        fseek(wav, 0, SEEK_END);
+    }
+
+    bool open ()
+    {
+        wav = fopen(path.c_str(), "wb");
+        cues = fopen((path + ".csv").c_str(), "w");
+        if (!wav || !cues)
+        {
+            fprintf(stderr, "Cannot write %s\n", path.c_str());
+            return false;
+        }
+        header();
+        fprintf(cues, "frame,seconds,latency_ms\n");
+        pacer.start();
+        return true;
+    }
+
+    bool write (const short *samples, int n)
+    {
+        // Samples are little endian in the file, as they are in memory here
+        pacer.wait(n);
+        frames += n;
+        return fwrite(samples, sizeof(short) * AUDIO_CHANNELS, n, wav) == (size_t)n;
+    }
+
+    void started (size_t frame, double latency_ms)
+    {
+        fprintf(cues, "%zu,%.6f,%.3f\n", frame, (double)frame / AUDIO_RATE, latency_ms);
+    }
+
+    void close ()
+    {
+        if (wav)
+        {
+            header();
+            fclose(wav);
+        }
+        if (cues) fclose(cues);
+        wav = cues = NULL;
+    }
+};
+
+AudioBackend *audio_wavfile (const char *path) { return new WavBackend(path); }
+
+AudioBackend *audio_backend (const char *name)
+{
+    if (!strcmp(name, "auto"))
+    {
+        AudioBackend *b = audio_alsa();
+        return b ? b : audio_aplay();
+    }
+    if (!strcmp(name, "alsa")) return audio_alsa();
+    if (!strcmp(name, "aplay")) return audio_aplay();
+    if (!strcmp(name, "null")) return audio_null(true);
+    if (!strncmp(name, "wav:", 4)) return audio_wavfile(name + 4);
+    return NULL;
+}
@@ -0,0 +1,215 @@
+#include "board.h"
+
+const char board_moves[NUM_MOVES] = {'U', 'D', 'L', 'R'};
+
+void Level::set (int i, int j, short v)
+{
+    Chunk *c = v != TILE_VOID ? map.insert(i >> CHUNK_BITS, j >> CHUNK_BITS) : map.find(i >> CHUNK_BITS, j >> CHUNK_BITS);
+    if (!c) return;
+    int k = chunkcell(i, j);
+    c->count += (v != TILE_VOID) - (c->tile[k] != TILE_VOID);
+    c->tile[k] = v;
+}
+
+void Level::setgroup (int i, int j, int g)
+{
+    Chunk *c = map.find(i >> CHUNK_BITS, j >> CHUNK_BITS);
+    if (c) c->group[chunkcell(i, j)] = g;
+}
+
+void board_prepare (Level &level)
+{
+    level.nfragile = 0;
+    level.ngroups = 0;
+    for (size_t n=0; n<level.map.chunks.size(); n++)
+    {
+        Chunk &c = level.map.chunks[n];
+        for (int k=0; k<CHUNK*CHUNK; k++)
+        {
+            c.fragile[k] = c.tile[k] == TILE_FRAGILE ? level.nfragile++ : -1;
+            if (c.tile[k] == TILE_SWITCH || c.tile[k] == TILE_BRIDGE)
+            {
+                if (level.ngroups < c.group[k] + 1) level.ngroups = c.group[k] + 1;
+            }
+            else c.group[k] = 0;
+        }
+    }
+}
+
+void board_init (Level &level, const char *name, int rows, int cols, const short *cells, int startx, int starty)
+{
+    level.name = name;
+    level.rows = rows;
+    level.cols = cols;
+    level.startx = startx;
+    level.starty = starty;
+    level.map.clear();
+    for (int i=0; i<rows; i++)
+        for (int j=0; j<cols; j++)
+            level.set(i, j, cells[i*cols + j]);
+    board_prepare(level);
+}
+
+State board_start (const Level &level)
+{
+    State s;
+    s.x = level.startx;
+    s.y = level.starty;
+    s.orientation = ORIENT_STANDING;
+    s.bridges = 0;
+    s.fallen = 0;
+    return s;
+}
+
+/* A cell the block cannot rest on: void, or a bridge whose group is not down yet */
+static bool unsupported (const Level &level, const State &s, int i, int j)
+{
+    short v = level.at(i, j);
+    return v == TILE_VOID || (v == TILE_BRIDGE && !(s.bridges >> level.groupat(i, j) & 1));
+}
+
+bool board_roll (const State &s, char move, State &out)
+{
+    out = s;
+    switch (move)
+    {
+        case 'U':
+            if (s.orientation == ORIENT_STANDING) { out.y += 1; out.orientation = ORIENT_LYING_Y; }
+            else if (s.orientation == ORIENT_LYING_Y) { out.y += 2; out.orientation = ORIENT_STANDING; }
+            else out.y += 1;
+            break;
+        case 'D':
+            if (s.orientation == ORIENT_STANDING) { out.y -= 2; out.orientation = ORIENT_LYING_Y; }
+            else if (s.orientation == ORIENT_LYING_Y) { out.y -= 1; out.orientation = ORIENT_STANDING; }
+            else out.y -= 1;
+            break;
+        case 'L':
+            if (s.orientation == ORIENT_STANDING) { out.x -= 2; out.orientation = ORIENT_LYING_X; }
+            else if (s.orientation == ORIENT_LYING_X) { out.x -= 1; out.orientation = ORIENT_STANDING; }
+            else out.x -= 1;
+            break;
+        case 'R':
+            if (s.orientation == ORIENT_STANDING) { out.x += 1; out.orientation = ORIENT_LYING_X; }
+            else if (s.orientation == ORIENT_LYING_X) { out.x += 2; out.orientation = ORIENT_STANDING; }
+            else out.x += 1;
+            break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+/* The move that rolls the block back */
+char board_reverse (char move)
+{
+    switch (move)
+    {
+        case 'U': return 'D';
+        case 'D': return 'U';
+        case 'L': return 'R';
+        case 'R': return 'L';
+    }
+    return move;
+}
+
+int board_step (const Level &level, const State &s, char move, State &out)
+{
+    // Roll the block (the discrete end result of the keybindings() animation)
+    if (!board_roll(s, move, out)) return MOVE_OK;
+
+    // Resting rules, in the order draw() checks them
+    if (out.orientation == ORIENT_STANDING)
+    {
+        short v = level.at(out.x, out.y);
+        unsigned int g = 1u << level.groupat(out.x, out.y);
+        if (v == TILE_SWITCH && !(out.bridges & g))
+        {
+            out.bridges |= g;
+            return MOVE_OK;
+        }
+        if (unsupported(level, out, out.x, out.y)) return MOVE_FALL;
+        if (v == TILE_FRAGILE)
+        {
+            // The tile drops and takes the block with it
+            int f = level.fragileat(out.x, out.y);
+            if (f < 64) out.fallen |= 1ULL << f;
+            return MOVE_FALL;
+        }
+        if (v == TILE_GOAL) return MOVE_GOAL;
+        return MOVE_OK;
+    }
+
+    int x2 = out.x + (out.orientation == ORIENT_LYING_X);
+    int y2 = out.y + (out.orientation == ORIENT_LYING_Y);
+    // A lying block tips over if either half hangs over the edge
+    if (unsupported(level, out, out.x, out.y) || unsupported(level, out, x2, y2)) return MOVE_FALL;
+    return MOVE_OK;
+}
+
+bool board_live (const Level &level, const State &s)
+{
+    if (s.fallen) return false;
+    if (s.orientation == ORIENT_STANDING)
+    {
+        short v = level.at(s.x, s.y);
+        if (v == TILE_SWITCH) return s.bridges >> level.groupat(s.x, s.y) & 1;
+        return v != TILE_FRAGILE && v != TILE_GOAL && !unsupported(level, s, s.x, s.y);
+    }
+    int x2 = s.x + (s.orientation == ORIENT_LYING_X);
+    int y2 = s.y + (s.orientation == ORIENT_LYING_Y);
+    return !unsupported(level, s, s.x, s.y) && !unsupported(level, s, x2, y2);
+}
+
+void board_predecessors (const Level &level, const State &t, std::vector<StateMove> &out)
+{
+    out.clear();
+
+    // Arriving on a switch may have just set its group's bit
+    unsigned int masks[2] = { t.bridges, t.bridges };
+    if (t.orientation == ORIENT_STANDING && level.at(t.x, t.y) == TILE_SWITCH)
+        masks[1] &= ~(1u << level.groupat(t.x, t.y));
+
+    for (int m=0; m<NUM_MOVES; m++)
+    {
+        StateMove p;
+        p.move = board_moves[m];
+        board_roll(t, board_reverse(p.move), p.from);
+        for (int k=0; k<2; k++)
+        {
+            if (k == 1 && masks[1] == masks[0]) break;
+            p.from.bridges = masks[k];
+            State check;
+            if (board_live(level, p.from) && board_step(level, p.from, p.move, check) == MOVE_OK && check == t)
+                out.push_back(p);
+        }
+    }
+}
+
+void board_goal_predecessors (const Level &level, std::vector<StateMove> &out)
+{
+    out.clear();
+    for (size_t n=0; n<level.map.chunks.size(); n++)
+    {
+        const Chunk &c = level.map.chunks[n];
+        for (int k=0; k<CHUNK*CHUNK; k++)
+        {
+            if (c.tile[k] != TILE_GOAL) continue;
+            State g = board_start(level);
+            g.x = c.cx*CHUNK + k/CHUNK;
+            g.y = c.cy*CHUNK + k%CHUNK;
+            for (int m=0; m<NUM_MOVES; m++)
+            {
+                StateMove p;
+                p.move = board_moves[m];
+                board_roll(g, board_reverse(p.move), p.from);
+                for (unsigned long long mask = 0; mask < (1ULL << level.ngroups); mask++)
+                {
+                    p.from.bridges = mask;
+                    State check;
+                    if (board_live(level, p.from) && board_step(level, p.from, p.move, check) == MOVE_GOAL)
+                        out.push_back(p);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,140 @@
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <string>
+#include <vector>
+
+#include "chunkmap.h"
+
+/* Game rules without any rendering: the tile grid and the block moves that
+   keybindings() and draw() animate. Shared by the game and the offline tools. */
+
+/* Tile values of a level grid */
+enum {
+    TILE_VOID = 0,
+    TILE_FLOOR = 1,
+    TILE_BRIDGE = 2,   // only supports the block once its group is activated
+    TILE_SWITCH = 3,   // activates its bridge group when the block stands on it
+    TILE_FRAGILE = 4,  // gives way under a standing block
+    TILE_GOAL = 5
+};
+
+/* Block orientations, same values as player.orientation */
+enum {
+    ORIENT_STANDING = 0,
+    ORIENT_LYING_Y = 1,  // covers (x,y) and (x,y+1)
+    ORIENT_LYING_X = 2   // covers (x,y) and (x+1,y)
+};
+
+/* Result of a move */
+enum {
+    MOVE_OK = 0,
+    MOVE_FALL,
+    MOVE_GOAL
+};
+
+/* Switch/bridge groups fit in State::bridges */
+#define MAX_GROUPS 32
+
+/* Moves in keybindings() order: U is +y, D is -y, L is -x, R is +x */
+#define NUM_MOVES 4
+extern const char board_moves[NUM_MOVES];
+
+struct Level
+{
+    std::string name;
+    int rows, cols;            // bounds: rows run along x (i), cols along y (j)
+    int startx, starty;
+    ChunkMap map;              // tiles, only where the board is not void
+    int ngroups;               // groups used by switches and bridges
+    int nfragile;              // fragile tiles
+
+    short at (int i, int j) const
+    {
+        if (i < 0 || j < 0 || i >= rows || j >= cols) return TILE_VOID;
+        const Chunk *c = map.find(i >> CHUNK_BITS, j >> CHUNK_BITS);
+        return c ? c->tile[chunkcell(i, j)] : TILE_VOID;
+    }
+
+    int groupat (int i, int j) const
+    {
+        if (i < 0 || j < 0 || i >= rows || j >= cols) return 0;
+        const Chunk *c = map.find(i >> CHUNK_BITS, j >> CHUNK_BITS);
+        return c ? c->group[chunkcell(i, j)] : 0;
+    }
+
+    /* Fragile tile number of (i,j), -1 if it is not fragile */
+    int fragileat (int i, int j) const
+    {
+        if (i < 0 || j < 0 || i >= rows || j >= cols) return -1;
+        const Chunk *c = map.find(i >> CHUNK_BITS, j >> CHUNK_BITS);
+        return c ? c->fragile[chunkcell(i, j)] : -1;
+    }
+
+    /* Change a tile; call board_prepare() once done */
+    void set (int i, int j, short v);
+    void setgroup (int i, int j, int g);
+};
+
+struct State
+{
+    short x, y;
+    short orientation;
+    unsigned int bridges;       // activated bridge groups, one bit per group
+    unsigned long long fallen;  // fallen fragile tiles, by fragile tile number
+
+    bool operator== (const State &o) const
+    {
+        return x == o.x && y == o.y && orientation == o.orientation &&
+               bridges == o.bridges && fallen == o.fallen;
+    }
+};
+
+struct StateHash
+{
+    size_t operator() (const State &s) const
+    {
+        size_t h = ((size_t)(unsigned short)s.x << 16 | (unsigned short)s.y) * 3 + s.orientation;
+        h = h * 1000003u ^ s.bridges;
+        h = h * 1000003u ^ (size_t)(s.fallen ^ (s.fallen >> 32));
+        return h;
+    }
+};
+
+/* Number the fragile tiles and count the groups once the tiles are set */
+void board_prepare (Level &level);
+
+/* Build a level from a dense rows x cols table of tile values, all in group 0 */
+void board_init (Level &level, const char *name, int rows, int cols, const short *cells, int startx = 1, int starty = 1);
+
+State board_start (const Level &level);
+
+/* Only the geometry of a move: where the block ends up, before any of the
+   resting rules. Returns false for an unknown move. */
+bool board_roll (const State &s, char move, State &out);
+
+/* The opposite move; rolling with it undoes the geometry of move */
+char board_reverse (char move);
+
+/* Apply one move and the resting rules of draw() to s.
+   Returns MOVE_OK with the new state in out, or MOVE_FALL / MOVE_GOAL. */
+int board_step (const Level &level, const State &s, char move, State &out);
+
+/* Whether s is a state the block can rest in */
+bool board_live (const Level &level, const State &s);
+
+/* A state and the move taken from it */
+struct StateMove
+{
+    State from;
+    char move;
+};
+
+/* Every live state that board_step() takes to t in one move */
+void board_predecessors (const Level &level, const State &t, std::vector<StateMove> &out);
+
+/* Every live state with a move into a goal hole, for each combination of
+   active bridge groups (2^ngroups of them, so keep ngroups small) */
+void board_goal_predecessors (const Level &level, std::vector<StateMove> &out);
+
+#endif
@@ -0,0 +1,71 @@
+#include <string.h>
+
+#include "chunkmap.h"
+
+using namespace std;
+
+static size_t chunkhash (int cx, int cy)
+{
+    unsigned long long k = (unsigned long long)(unsigned int)cx << 32 | (unsigned int)cy;
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    return (size_t)k;
+}
+
+const Chunk *ChunkMap::find (int cx, int cy) const
+{
+    if (slots.empty()) return NULL;
+    size_t mask = slots.size() - 1;
+    for (size_t h = chunkhash(cx, cy) & mask; slots[h] >= 0; h = (h + 1) & mask)
+    {
+        const Chunk &c = chunks[slots[h]];
+        if (c.cx == cx && c.cy == cy) return &c;
+    }
+    return NULL;
+}
+
+Chunk *ChunkMap::find (int cx, int cy)
+{
+    return const_cast<Chunk *>(static_cast<const ChunkMap *>(this)->find(cx, cy));
+}
+
+Chunk *ChunkMap::insert (int cx, int cy)
+{
+    Chunk *found = find(cx, cy);
+    if (found) return found;
+
+    // Keep the table at most half full so probe runs stay short
+    if ((chunks.size() + 1) * 2 > slots.size())
+    {
+        size_t n = slots.empty() ? 16 : slots.size() * 2;
+        slots.assign(n, -1);
+        for (size_t c=0; c<chunks.size(); c++)
+        {
+            size_t h = chunkhash(chunks[c].cx, chunks[c].cy) & (n - 1);
+            while (slots[h] >= 0) h = (h + 1) & (n - 1);
+            slots[h] = c;
+        }
+    }
+
+    chunks.push_back(Chunk());
+    Chunk &c = chunks.back();
+    c.cx = cx;
+    c.cy = cy;
+    c.count = 0;
+    memset(c.tile, 0, sizeof(c.tile));
+    memset(c.group, 0, sizeof(c.group));
+    memset(c.fragile, 0xff, sizeof(c.fragile));
+
+    size_t mask = slots.size() - 1;
+    size_t h = chunkhash(cx, cy) & mask;
+    while (slots[h] >= 0) h = (h + 1) & mask;
+    slots[h] = chunks.size() - 1;
+    return &c;
+}
+
+void ChunkMap::clear ()
+{
+    chunks.clear();
+    slots.clear();
+}
@@ -0,0 +1,44 @@
+#ifndef CHUNKMAP_H
+#define CHUNKMAP_H
+
+#include <vector>
+
+/* Sparse tile storage: the board is cut into CHUNK x CHUNK squares and only
+   squares holding a non-void tile exist, found through an open addressing
+   hash keyed by chunk coordinate. */
+
+#define CHUNK_BITS 4
+#define CHUNK (1 << CHUNK_BITS)
+#define CHUNK_MASK (CHUNK - 1)
+
+struct Chunk
+{
+    int cx, cy;                          // covers cells (cx*CHUNK.., cy*CHUNK..)
+    int count;                           // non-void tiles
+    unsigned char tile[CHUNK*CHUNK];     // tile values, row-major within the chunk
+    unsigned char group[CHUNK*CHUNK];    // switch/bridge group
+    short fragile[CHUNK*CHUNK];          // fragile tile number, -1 if none
+};
+
+struct ChunkMap
+{
+    std::vector<Chunk> chunks;  // occupied chunks, in insertion order
+    std::vector<int> slots;     // power of two table of chunk indices, -1 if empty
+
+    const Chunk *find (int cx, int cy) const;
+    Chunk *find (int cx, int cy);
+
+    /* The chunk at (cx,cy), created empty if missing. Pointers into chunks
+       stay valid only until the next insert. */
+    Chunk *insert (int cx, int cy);
+
+    void clear ();
+};
+
+/* Index of cell (i,j) inside its chunk */
+inline int chunkcell (int i, int j)
+{
+    return (i & CHUNK_MASK) * CHUNK + (j & CHUNK_MASK);
+}
+
+#endif
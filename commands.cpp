@@ -0,0 +1,387 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include "audio.h"
+#include "commands.h"
+#include "farm.h"
+#include "mixer.h"
+#include "prune.h"
+
+using namespace std;
+
+/* Resolve a level argument: a 1-based number into the pack, or a source file */
+static bool pick_level (const vector<LevelData> &levels, const char *which, Level &level)
+{
+    char *end;
+    long n = strtol(which, &end, 10);
+    if (*which && !*end)
+    {
+        if (n < 1 || n > (long)levels.size())
+        {
+            fprintf(stderr, "There is no level %ld (the pack has %u)\n", n, (unsigned int)levels.size());
+            return false;
+        }
+        level = levels[n-1].level;
+        return true;
+    }
+
+    string err;
+    if (!level_parse(which, level, err))
+    {
+        fprintf(stderr, "%s\n", err.c_str());
+        return false;
+    }
+    return true;
+}
+
+int command_solve (const vector<LevelData> &levels, const char *which, const SolveOptions &opt)
+{
+    const char *algo = opt.algo;
+    Level level;
+    if (!pick_level(levels, which, level)) return 2;
+
+    Solution sol;
+    if (!strcmp(algo, "astar")) solver_astar(level, sol);
+    else if (!strcmp(algo, "pruned"))
+    {
+        Pruner prune;
+        pruner_init(level, prune);
+        printf("Board symmetries: %u\n", (unsigned int)prune.symmetries.size());
+        solver_pruned_bfs(level, sol, prune);
+    }
+    else if (!strcmp(algo, "bidir"))
+    {
+        if (!solver_bidirectional(level, sol)) return 2;
+    }
+    else if (!strcmp(algo, "external"))
+    {
+        if (!solver_external_bfs(level, sol, opt.tmpdir, opt.memory)) return 2;
+    }
+    else if (strcmp(algo, "bfs"))
+    {
+        fprintf(stderr, "Unknown search '%s' (use bfs, astar, bidir, pruned or external)\n", algo);
+        return 2;
+    }
+    else if (opt.nthreads > 1)
+    {
+        if (!solver_parallel_bfs(level, sol, opt.nthreads)) return 2;
+    }
+    else solver_bfs(level, sol);
+
+    printf("Level: %s\n", level.name.c_str());
+    if (sol.moves < 0)
+    {
+        printf("No solution (%u states explored)\n", (unsigned int)sol.visited);
+        return 1;
+    }
+    printf("Optimal solution: %d moves\n", sol.moves);
+    for (size_t m=0; m<sol.path.size(); m++) printf(m ? " %c" : "%c", sol.path[m]);
+    printf("\n");
+    printf("States explored: %u\n", (unsigned int)sol.visited);
+    printf("Nodes expanded: %u\n", (unsigned int)sol.expanded);
+    return 0;
+}
+
+/* Result of validating one level */
+struct LevelReport
+{
+    string problems;    // ';' separated, empty if the level is fine
+    int moves;
+    size_t states;
+    double ms;
+};
+
+static void addproblem (string &problems, const char *p)
+{
+    if (!problems.empty()) problems += ';';
+    problems += p;
+}
+
+/* Everything that is wrong with a level short of solving it; false if it
+   must not be solved, as the search ranks states by cell within the grid
+   and would index past its tables from a start or cell outside it */
+static bool checklevel (const LevelData &data, LevelReport &rep)
+{
+    const Level &lv = data.level;
+    bool outside = false, goal = false;
+    for (size_t n=0; n<lv.map.chunks.size(); n++)
+    {
+        const Chunk &c = lv.map.chunks[n];
+        for (int k=0; k<CHUNK*CHUNK; k++)
+        {
+            if (c.tile[k] == TILE_VOID) continue;
+            int i = c.cx*CHUNK + k/CHUNK, j = c.cy*CHUNK + k%CHUNK;
+            if (i < 0 || j < 0 || i >= lv.rows || j >= lv.cols) outside = true;
+            else if (c.tile[k] == TILE_GOAL) goal = true;
+        }
+    }
+    bool start = board_live(lv, board_start(lv));
+    if (outside) addproblem(rep.problems, "cells_out_of_bounds");
+    if (!goal) addproblem(rep.problems, "no_goal");
+    if (!start) addproblem(rep.problems, "bad_start");
+    return start && !outside;
+}
+
+static string jsonstring (const string &s)
+{
+    string out = "\"";
+    for (size_t k=0; k<s.size(); k++)
+    {
+        char c = s[k];
+        if (c == '"' || c == '\\') out += '\\';
+        if ((unsigned char)c < 0x20)
+        {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out += esc;
+        }
+        else out += c;
+    }
+    return out + "\"";
+}
+
+static string csvstring (const string &s)
+{
+    if (s.find_first_of(",\"\n") == string::npos) return s;
+    string out = "\"";
+    for (size_t k=0; k<s.size(); k++)
+    {
+        if (s[k] == '"') out += '"';
+        out += s[k];
+    }
+    return out + "\"";
+}
+
+/* Solve one level and record what the validator reports about it */
+static void validatelevel (const LevelData &data, LevelReport &rep)
+{
+    if (!checklevel(data, rep))
+    {
+        rep.moves = -1;
+        rep.states = 0;
+        rep.ms = 0;
+        addproblem(rep.problems, "unsolvable");
+        return;
+    }
+
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    Solution sol;
+    solver_bfs(data.level, sol);
+    rep.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - t0).count();
+    rep.moves = sol.moves;
+    rep.states = sol.visited;
+
+    if (sol.moves < 0) addproblem(rep.problems, "unsolvable");
+    if (data.hasmeta && data.optimal != sol.moves) addproblem(rep.problems, "stale_metadata");
+}
+
+/* Validate every level in forked worker processes; a level whose workers
+   keep crashing or running past timeout seconds is reported as
+   worker_crashed or timeout, one no worker was left for as not_run */
+static bool farmvalidate (const vector<LevelData> &levels, int nworkers, int timeout, const char *tmpdir, vector<LevelReport> &reports)
+{
+    // Reports cross the socket as "moves states ms problems"
+    auto work = [&] (size_t l)
+    {
+        LevelReport rep;
+        validatelevel(levels[l], rep);
+        char buf[64];
+        snprintf(buf, sizeof(buf), "%d %zu %.3f ", rep.moves, rep.states, rep.ms);
+        return buf + rep.problems;
+    };
+
+    // The socket goes in a private directory, not at a name others can guess
+    string tmpl = string(tmpdir) + "/tumblerz-farm-XXXXXX";
+    vector<char> dirname(tmpl.begin(), tmpl.end());
+    dirname.push_back(0);
+    if (!mkdtemp(&dirname[0]))
+    {
+        fprintf(stderr, "Cannot create a work directory in %s\n", tmpdir);
+        return false;
+    }
+    Transport *transport = unix_transport(string(&dirname[0]) + "/farm.sock");
+    vector<string> results;
+    vector<int> status;
+    bool ok = farm_run(*transport, levels.size(), nworkers, timeout * 1000, work, results, status);
+    delete transport;
+    rmdir(&dirname[0]);
+    if (!ok) return false;
+
+    for (size_t l=0; l<levels.size(); l++)
+    {
+        LevelReport &rep = reports[l];
+        int used = 0;
+        if (status[l] != FARM_DONE || sscanf(results[l].c_str(), "%d %zu %lf %n", &rep.moves, &rep.states, &rep.ms, &used) < 3)
+        {
+            rep = LevelReport();
+            rep.moves = -1;
+            addproblem(rep.problems, status[l] == FARM_TIMEOUT ? "timeout" : status[l] == FARM_NOT_RUN ? "not_run" : "worker_crashed");
+        }
+        else rep.problems = results[l].substr(used);
+    }
+    return true;
+}
+
+int command_validate (const char *path, const char *format, int nthreads, int nworkers, int timeout, const char *tmpdir)
+{
+    bool json = !strcmp(format, "json");
+    if (!json && strcmp(format, "csv"))
+    {
+        fprintf(stderr, "Unknown format '%s' (use csv or json)\n", format);
+        return 2;
+    }
+
+    vector<LevelData> levels;
+    if (!pack_read(path, levels))
+    {
+        fprintf(stderr, "Cannot read level pack %s\n", path);
+        return 2;
+    }
+    if (nthreads < 1) nthreads = thread::hardware_concurrency();
+    if (nthreads < 1) nthreads = 1;
+
+    vector<LevelReport> reports(levels.size());
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    if (nworkers > 0)
+    {
+        if (!farmvalidate(levels, nworkers, timeout, tmpdir, reports)) return 2;
+    }
+    else
+    {
+        // Thread pool: each worker takes the next unsolved level
+        atomic<size_t> next(0);
+        auto worker = [&] ()
+        {
+            for (size_t l; (l = next++) < levels.size(); )
+                validatelevel(levels[l], reports[l]);
+        };
+
+        vector<thread> threads;
+        for (int t=1; t<nthreads; t++) threads.push_back(thread(worker));
+        worker();
+        for (size_t t=0; t<threads.size(); t++) threads[t].join();
+    }
+    double total = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    int bad = 0;
+    size_t states = 0;
+    if (json) printf("[\n");
+    else printf("level,name,status,optimal_moves,states,solve_ms\n");
+    for (size_t l=0; l<levels.size(); l++)
+    {
+        const LevelReport &rep = reports[l];
+        string status = rep.problems.empty() ? "ok" : rep.problems;
+        bad += !rep.problems.empty();
+        states += rep.states;
+        if (json)
+            printf("  {\"level\": %u, \"name\": %s, \"status\": %s, \"optimal_moves\": %d, \"states\": %u, \"solve_ms\": %.3f}%s\n",
+                   (unsigned int)l + 1, jsonstring(levels[l].level.name).c_str(), jsonstring(status).c_str(),
+                   rep.moves, (unsigned int)rep.states, rep.ms, l + 1 < levels.size() ? "," : "");
+        else
+            printf("%u,%s,%s,%d,%u,%.3f\n", (unsigned int)l + 1, csvstring(levels[l].level.name).c_str(),
+                   csvstring(status).c_str(), rep.moves, (unsigned int)rep.states, rep.ms);
+    }
+    if (json) printf("]\n");
+
+    // Throughput goes to stderr so the report stays machine readable
+    fprintf(stderr, "%u levels, %d with problems, %.3f s on %d %s, %.0f states/s\n",
+            (unsigned int)levels.size(), bad, total, nworkers > 0 ? nworkers : nthreads,
+            nworkers > 0 ? "worker processes" : "threads", total > 0 ? states / total : 0.0);
+    return bad ? 1 : 0;
+}
+
+int command_audiobench (const char *backend, const char *sound)
+{
+    int id = audio_load(sound);
+    if (id < 0) return 2;
+    AudioBackend *b = audio_backend(backend);
+    if (!b)
+    {
+        fprintf(stderr, "Audio backend '%s' is unknown or not built in (use alsa, aplay, null or wav:<file>)\n", backend);
+        return 2;
+    }
+    if (!audio_init(b)) return 2;
+
+    const int triggers = 50;
+    for (int k=0; k<triggers; k++)
+    {
+        audio_play(id);
+        this_thread::sleep_for(chrono::milliseconds(40));
+    }
+    audio_shutdown();
+
+    AudioStats st = audio_stats();
+    double periodms = 1000.0 * AUDIO_PERIOD / AUDIO_RATE;
+    printf("Sounds started: %u of %d, %u voices stolen\n", (unsigned int)st.started, triggers, (unsigned int)st.stolen);
+    printf("Latency: %.3f ms average, %.3f ms max\n", st.started ? st.latencyms / st.started : 0.0, st.maxlatencyms);
+    printf("Mixer: %.3f us per %d frame period, %.4f%% of real time\n", st.periods ? 1000 * st.mixms / st.periods : 0.0,
+           AUDIO_PERIOD, st.periods ? 100 * st.mixms / (st.periods * periodms) : 0.0);
+    return st.started == (size_t)triggers ? 0 : 1;
+}
+
+/* Seconds of CPU one call of f takes, averaged over at least 0.2 s */
+template <class F> static double timeit (F f)
+{
+    chrono::steady_clock::time_point t0 = chrono::steady_clock::now();
+    size_t runs = 0;
+    double s;
+    do
+    {
+        f();
+        runs++;
+        s = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+    } while (s < 0.2);
+    return s / runs;
+}
+
+int command_mixbench ()
+{
+    const int frames = AUDIO_PERIOD * 16, samples = frames * AUDIO_CHANNELS;
+    const unsigned int step = MIX_STEP_ONE * 147 / 160;   // 48 kHz material played at 44.1 kHz
+    const int outframes = (int)(((unsigned long long)(frames - 1) << 16) / step) - 1;
+
+    vector<short> src(samples);
+    unsigned int seed = 1;
+    for (int i=0; i<samples; i++) src[i] = (short)((seed = seed * 1103515245 + 12345) >> 16);
+
+    const MixKernels *sets[3];
+    int nsets = mix_available(sets, 3);
+    vector<short> reference;
+    int bad = 0;
+    for (int k=0; k<nsets; k++)
+    {
+        const MixKernels &m = *sets[k];
+        vector<int> acc(max(samples, outframes * AUDIO_CHANNELS));
+        vector<short> out(acc.size());
+
+        // Same input, same bits out as the plain C++ kernels
+        m.add(&acc[0], &src[0], samples, MIX_UNITY * 3 / 4);
+        m.addresampled(&acc[0], &src[1 * AUDIO_CHANNELS], 0x1234, step, outframes, MIX_UNITY);
+        m.add(&acc[0], &src[0], samples - 3, MIX_UNITY * 7 / 4);
+        m.clamp(&out[0], &acc[0], acc.size());
+        if (k == 0) reference = out;
+        else if (out != reference)
+        {
+            printf("%s: output differs from %s\n", m.name, sets[0]->name);
+            bad++;
+        }
+
+        double add = timeit([&] () { m.add(&acc[0], &src[0], samples, MIX_UNITY); });
+        double res = timeit([&] () { m.addresampled(&acc[0], &src[0], 0, step, outframes, MIX_UNITY); });
+        double clamp = timeit([&] () { m.clamp(&out[0], &acc[0], samples); });
+
+        // Worst case period: every voice resampled
+        double period = (res / outframes * AUDIO_VOICES + clamp / frames) * AUDIO_PERIOD;
+        printf("%-6s add %7.0f  resample %7.0f  clamp %7.0f Msamples/s, %d resampled voices: %.4f%% of a core\n",
+               m.name, samples / add / 1e6, outframes * AUDIO_CHANNELS / res / 1e6, samples / clamp / 1e6,
+               AUDIO_VOICES, 100 * period * AUDIO_RATE / AUDIO_PERIOD);
+    }
+    printf("Using %s\n", mix_kernels().name);
+    return bad ? 1 : 0;
+}
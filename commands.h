@@ -0,0 +1,42 @@
+#ifndef COMMANDS_H
+#define COMMANDS_H
+
+#include <vector>
+
+#include "levelpack.h"
+
+/* Headless modes of sample3D, run from main() instead of opening a window.
+   Each returns the process exit status. */
+
+/* Options of --solve */
+struct SolveOptions
+{
+    const char *algo;     // "bfs", "astar", "bidir", "pruned" or "external"
+    int nthreads;         // bfs on more than one thread selects the parallel search
+    const char *tmpdir;   // where the external search keeps its layer files
+    size_t memory;        // bytes the external search may buffer
+};
+
+/* --solve <level>: level is a number in the loaded pack or a .lvl source */
+int command_solve (const std::vector<LevelData> &levels, const char *which, const SolveOptions &opt);
+
+/* --validate-pack <file>: solve every level of a pack on nthreads workers
+   (every core if 0) and report problems, optimal moves, state count and
+   solve time per level. format is "csv" or "json". Returns 1 if any level
+   has a problem. With nworkers > 0 the levels are solved by that many
+   worker processes instead (a crashing level does not take the run down),
+   talking to this one over a Unix socket in tmpdir; a level still solving
+   after timeout seconds (0 for no limit) is killed and retried. */
+int command_validate (const char *path, const char *format, int nthreads, int nworkers, int timeout, const char *tmpdir);
+
+/* --audio-bench <backend>: trigger sound every 40 ms for two seconds through
+   an audio backend (see audio_backend()) and report trigger-to-output
+   latency and mixer CPU cost */
+int command_audiobench (const char *backend, const char *sound);
+
+/* --mix-bench: time each mixer kernel set this CPU runs, check that they
+   agree with the plain C++ one and report samples per second and the share
+   of a core a full voice pool would take */
+int command_mixbench ();
+
+#endif
@@ -0,0 +1,70 @@
+#include "distfield.h"
+
+using namespace std;
+
+/* Index graph states from field.nindexed on */
+static void indexstates (DistanceField &field)
+{
+    const StateGraph &g = field.data->graph;
+    for (size_t s = field.nindexed; s < g.states.size(); s++)
+    {
+        // A repaired graph may keep states from a group that no longer exists
+        if (field.codec.ngroups < 32 && g.states[s].bridges >> field.codec.ngroups) continue;
+        unsigned long long r = field.codec.rank(g.states[s]);
+        if (!field.index.empty()) field.index[r] = s;
+        else field.sparse[r] = s;
+    }
+    field.nindexed = g.states.size();
+}
+
+void field_build (const LevelData &data, DistanceField &field)
+{
+    field.data = &data;
+    field.codec = state_codec(data.level);
+    field.index.clear();
+    field.sparse.clear();
+    field.nindexed = 0;
+    if (field.codec.nranks <= MAX_FIELD_RANKS) field.index.assign(field.codec.nranks, -1);
+    indexstates(field);
+}
+
+void field_refresh (DistanceField &field)
+{
+    if (field.codec.ngroups != field.data->level.ngroups) field_build(*field.data, field);
+    else indexstates(field);
+}
+
+int DistanceField::find (const State &s) const
+{
+    if (s.fallen || (codec.ngroups < 32 && s.bridges >> codec.ngroups) || s.x < 0 || s.y < 0 || s.x >= data->level.rows || s.y >= data->level.cols) return -1;
+    unsigned long long r = codec.rank(s);
+    if (!index.empty()) return index[r];
+    unordered_map<unsigned long long, int>::const_iterator it = sparse.find(r);
+    return it == sparse.end() ? -1 : it->second;
+}
+
+int field_distance (const DistanceField &field, const State &s)
+{
+    int i = field.find(s);
+    return i < 0 ? -1 : field.data->graph.dist[i];
+}
+
+bool field_doomed (const DistanceField &field, const State &s)
+{
+    return field_distance(field, s) < 0;
+}
+
+char field_hint (const DistanceField &field, const State &s)
+{
+    const StateGraph &g = field.data->graph;
+    int i = field.find(s);
+    if (i < 0 || g.dist[i] < 0) return 0;
+
+    for (int m=0; m<NUM_MOVES; m++)
+    {
+        unsigned int t = g.next[i*NUM_MOVES + m];
+        if (t == TRANS_GOAL) return board_moves[m];
+        if (t != TRANS_FALL && g.dist[t] == g.dist[i] - 1) return board_moves[m];
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+#ifndef DISTFIELD_H
+#define DISTFIELD_H
+
+#include <unordered_map>
+#include <vector>
+
+#include "levelpack.h"
+#include "statekey.h"
+
+/* Goal distances of a level keyed by state rank, so the game can ask how
+   far the block is from a solution, and which move gets closer, in O(1).
+   Built from the StateGraph that levelc stores in the pack (or that
+   level_precompute() fills at load). */
+
+/* Largest rank table before falling back to a hash map of the reachable
+   states: 16 MB, so loading a level in the game stays cheap */
+#define MAX_FIELD_RANKS (1ULL << 22)
+
+struct DistanceField
+{
+    const LevelData *data;
+    StateCodec codec;
+    std::vector<int> index;                               // rank -> state, -1 if unreachable
+    std::unordered_map<unsigned long long, int> sparse;   // the same, on huge state spaces
+    size_t nindexed;                                      // graph states indexed so far
+
+    /* Graph index of s, -1 if it cannot be reached from the start */
+    int find (const State &s) const;
+};
+
+/* Build the field of a level; data must outlive it and have its metadata */
+void field_build (const LevelData &data, DistanceField &field);
+
+/* Catch up with a graph that resolve_update() repaired: index the states
+   appended since, or rebuild if the level gained a bridge group */
+void field_refresh (DistanceField &field);
+
+/* Moves from s to the goal, -1 if the goal cannot be reached from s */
+int field_distance (const DistanceField &field, const State &s);
+
+/* Whether the goal is out of reach from s: a reachable state with no path
+   left, or one the level never leads to (a fall, say) */
+bool field_doomed (const DistanceField &field, const State &s);
+
+/* A move that brings s one step closer to the goal, 0 if there is none */
+char field_hint (const DistanceField &field, const State &s);
+
+#endif
@@ -0,0 +1,369 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <string>
+#include <utility>
+
+#include "solver.h"
+#include "statekey.h"
+
+using namespace std;
+
+/* Ranks moved per read or write call */
+#define IO_BLOCK (1 << 16)
+
+/* Most runs merged at once; more are first merged in groups of this many */
+#define MAX_FANIN 64
+
+/* Buffered sequential reader of a file of sorted ranks; remembers a failed
+   read, which next() reports like the end of the file */
+struct RunReader
+{
+    FILE *f;
+    vector<unsigned long long> buf;
+    size_t pos, n;
+    bool ok;
+
+    RunReader () : f(NULL), pos(0), n(0), ok(true) {}
+    RunReader (const RunReader &) = delete;
+    ~RunReader () { close(); }
+
+    bool open (const string &path, size_t block = IO_BLOCK)
+    {
+        f = fopen(path.c_str(), "rb");
+        buf.resize(block);
+        pos = n = 0;
+        ok = f != NULL;
+        return ok;
+    }
+
+    bool next (unsigned long long &r)
+    {
+        if (pos == n)
+        {
+            n = fread(&buf[0], sizeof(buf[0]), buf.size(), f);
+            pos = 0;
+            if (n == 0)
+            {
+                if (ferror(f)) ok = false;
+                return false;
+            }
+        }
+        r = buf[pos++];
+        return true;
+    }
+
+    /* False if a read failed */
+    bool close ()
+    {
+        if (f) fclose(f);
+        f = NULL;
+        return ok;
+    }
+};
+
+/* Buffered sequential writer; remembers a failed write */
+struct RunWriter
+{
+    FILE *f;
+    vector<unsigned long long> buf;
+    size_t count;
+    bool ok;
+
+    RunWriter () : f(NULL), count(0), ok(true) {}
+    RunWriter (const RunWriter &) = delete;
+    ~RunWriter () { if (f) fclose(f); }
+
+    bool open (const string &path)
+    {
+        f = fopen(path.c_str(), "wb");
+        buf.clear();
+        buf.reserve(IO_BLOCK);
+        count = 0;
+        ok = f != NULL;
+        return ok;
+    }
+
+    void put (unsigned long long r)
+    {
+        buf.push_back(r);
+        count++;
+        if (buf.size() == IO_BLOCK) flush();
+    }
+
+    void flush ()
+    {
+        if (!buf.empty() && fwrite(&buf[0], sizeof(buf[0]), buf.size(), f) != buf.size()) ok = false;
+        buf.clear();
+    }
+
+    bool close ()
+    {
+        if (!f) return false;
+        flush();
+        if (fclose(f)) ok = false;
+        f = NULL;
+        return ok;
+    }
+};
+
+static string runpath (const string &dir, const char *kind, size_t n)
+{
+    char name[64];
+    snprintf(name, sizeof(name), "/%s.%u", kind, (unsigned int)n);
+    return dir + name;
+}
+
+/* Sort a buffer of successors and write it out as one run */
+static bool writerun (const string &path, vector<unsigned long long> &buf)
+{
+    sort(buf.begin(), buf.end());
+    buf.erase(unique(buf.begin(), buf.end()), buf.end());
+    RunWriter w;
+    if (!w.open(path)) return false;
+    for (size_t k=0; k<buf.size(); k++) w.put(buf[k]);
+    buf.clear();
+    return w.close();
+}
+
+/* Ranks each of nfiles readers may buffer for the merge to stay in memory */
+static size_t readblock (size_t memory, size_t nfiles)
+{
+    size_t n = memory / sizeof(unsigned long long) / nfiles;
+    return n < 1024 ? 1024 : n > IO_BLOCK ? IO_BLOCK : n;
+}
+
+/* Merge sorted runs into one at path, dropping duplicates */
+static bool mergeruns (const vector<string> &runs, const string &path, size_t memory)
+{
+    typedef pair<unsigned long long, size_t> Head;
+    vector<RunReader> in(runs.size());
+    priority_queue<Head, vector<Head>, greater<Head> > heads;
+    size_t block = readblock(memory, runs.size());
+    for (size_t k=0; k<runs.size(); k++)
+    {
+        unsigned long long r;
+        if (!in[k].open(runs[k], block)) return false;
+        if (in[k].next(r)) heads.push(Head(r, k));
+    }
+
+    RunWriter out;
+    if (!out.open(path)) return false;
+    bool have = false;
+    unsigned long long last = 0;
+    while (!heads.empty())
+    {
+        Head h = heads.top();
+        heads.pop();
+        unsigned long long r;
+        if (in[h.second].next(r)) heads.push(Head(r, h.second));
+        if (have && h.first == last) continue;
+        have = true;
+        last = h.first;
+        out.put(h.first);
+    }
+
+    bool readok = true;
+    for (size_t k=0; k<in.size(); k++) readok = in[k].close() && readok;
+    return out.close() && readok;
+}
+
+/* Merge the runs, drop what is already in visited, and write the new states
+   both as the next layer and merged into a fresh copy of visited */
+static bool mergelayer (const vector<string> &runs, const string &visited, const string &layer,
+                        const string &newvisited, size_t memory, size_t &added)
+{
+    typedef pair<unsigned long long, size_t> Head;
+    vector<RunReader> in(runs.size());
+    priority_queue<Head, vector<Head>, greater<Head> > heads;
+    size_t block = readblock(memory, runs.size() + 1);
+    for (size_t k=0; k<runs.size(); k++)
+    {
+        unsigned long long r;
+        if (!in[k].open(runs[k], block)) return false;
+        if (in[k].next(r)) heads.push(Head(r, k));
+    }
+
+    RunReader old;
+    RunWriter out, all;
+    if (!old.open(visited, block) || !out.open(layer) || !all.open(newvisited)) return false;
+    unsigned long long v;
+    bool more = old.next(v);
+    bool have = false;
+    unsigned long long last = 0;
+
+    while (!heads.empty())
+    {
+        Head h = heads.top();
+        heads.pop();
+        unsigned long long r;
+        if (in[h.second].next(r)) heads.push(Head(r, h.second));
+        if (have && h.first == last) continue;
+        have = true;
+        last = h.first;
+
+        // Advance the visited stream past everything smaller
+        while (more && v < h.first)
+        {
+            all.put(v);
+            more = old.next(v);
+        }
+        if (more && v == h.first) continue;
+        out.put(h.first);
+        all.put(h.first);
+    }
+    while (more)
+    {
+        all.put(v);
+        more = old.next(v);
+    }
+
+    bool readok = old.close();
+    for (size_t k=0; k<in.size(); k++) readok = in[k].close() && readok;
+    added = out.count;
+    return out.close() & all.close() & readok;
+}
+
+bool solver_external_bfs (const Level &level, Solution &sol, const char *tmpdir, size_t memory)
+{
+    sol.moves = -1;
+    sol.path.clear();
+    sol.expanded = 0;
+    sol.visited = 0;
+
+    StateCodec codec = state_codec(level);
+    string tmpl = string(tmpdir) + "/tumblerz-bfs-XXXXXX";
+    vector<char> dirname(tmpl.begin(), tmpl.end());
+    dirname.push_back(0);
+    if (!mkdtemp(&dirname[0]))
+    {
+        fprintf(stderr, "Cannot create a work directory in %s\n", tmpdir);
+        return false;
+    }
+    string dir = &dirname[0];
+
+    // Successor buffer: what the memory budget allows, at least one block
+    size_t cap = max((size_t)IO_BLOCK, memory / sizeof(unsigned long long));
+    vector<unsigned long long> buf;
+    vector<string> layers, runs;
+    size_t nmerged = 0;
+    string visited = dir + "/visited";
+    bool ok = true, found = false;
+    unsigned long long goalstate = 0;
+    char goalmove = 0;
+
+    unsigned long long r = codec.rank(board_start(level));
+    layers.push_back(runpath(dir, "layer", 0));
+    buf.assign(1, r);
+    ok = writerun(layers[0], buf);
+    buf.assign(1, r);
+    ok = ok && writerun(visited, buf);
+    sol.visited = 1;
+
+    while (ok && !found)
+    {
+        // Expand the newest layer into sorted runs
+        RunReader frontier;
+        ok = frontier.open(layers.back());
+        while (ok && !found && frontier.next(r))
+        {
+            State s = codec.unrank(r);
+            sol.expanded++;
+            for (int m=0; m<NUM_MOVES; m++)
+            {
+                State t;
+                int res = board_step(level, s, board_moves[m], t);
+                if (res == MOVE_FALL) continue;
+                if (res == MOVE_GOAL)
+                {
+                    found = true;
+                    goalstate = r;
+                    goalmove = board_moves[m];
+                    break;
+                }
+                buf.push_back(codec.rank(t));
+            }
+            if (buf.size() >= cap)
+            {
+                runs.push_back(runpath(dir, "run", runs.size()));
+                ok = writerun(runs.back(), buf);
+            }
+        }
+        ok = frontier.close() && ok;
+        if (!ok || found) break;
+        if (!buf.empty())
+        {
+            runs.push_back(runpath(dir, "run", runs.size()));
+            ok = writerun(runs.back(), buf);
+        }
+
+        // The merges take the memory the successor buffer had. Too many runs
+        // are merged down in groups first, so the open files and their
+        // buffers stay bounded.
+        vector<unsigned long long>().swap(buf);
+        while (ok && runs.size() > MAX_FANIN)
+        {
+            vector<string> merged;
+            for (size_t k=0; k<runs.size(); k += MAX_FANIN)
+            {
+                vector<string> group(runs.begin() + k, runs.begin() + min(k + MAX_FANIN, runs.size()));
+                merged.push_back(runpath(dir, "merged", nmerged++));
+                ok = ok && mergeruns(group, merged.back(), memory);
+                for (size_t g=0; g<group.size(); g++) remove(group[g].c_str());
+            }
+            runs.swap(merged);
+        }
+
+        // Duplicate detection by merging against everything seen so far
+        size_t added = 0;
+        string next = runpath(dir, "layer", layers.size()), merged = dir + "/visited.new";
+        ok = ok && mergelayer(runs, visited, next, merged, memory, added) && rename(merged.c_str(), visited.c_str()) == 0;
+        for (size_t k=0; k<runs.size(); k++) remove(runs[k].c_str());
+        runs.clear();
+        layers.push_back(next);
+        sol.visited += added;
+        if (added == 0) break;
+    }
+
+    // The goal was reached from the last layer: walk back through the layer files
+    if (ok && found)
+    {
+        sol.path = goalmove;
+        State cur = codec.unrank(goalstate);
+        for (size_t k = layers.size() - 1; ok && k-- > 0; )
+        {
+            RunReader in;
+            bool linked = false;
+            ok = in.open(layers[k]);
+            while (ok && !linked && in.next(r))
+            {
+                State p = codec.unrank(r);
+                for (int m=0; m<NUM_MOVES && !linked; m++)
+                {
+                    State t;
+                    if (board_step(level, p, board_moves[m], t) == MOVE_OK && t == cur)
+                    {
+                        sol.path += board_moves[m];
+                        cur = p;
+                        linked = true;
+                    }
+                }
+            }
+            ok = in.close() && ok;
+        }
+        reverse(sol.path.begin(), sol.path.end());
+        sol.moves = sol.path.size();
+    }
+
+    for (size_t k=0; k<layers.size(); k++) remove(layers[k].c_str());
+    for (size_t k=0; k<runs.size(); k++) remove(runs[k].c_str());
+    remove(visited.c_str());
+    remove((dir + "/visited.new").c_str());
+    rmdir(dir.c_str());
+    if (!ok) fprintf(stderr, "I/O error in the external search under %s\n", tmpdir);
+    return ok;
+}
@@ -0,0 +1,300 @@
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+
+#include "farm.h"
+
+using namespace std;
+
+/* Largest message either side accepts */
+#define MAX_MESSAGE (64 << 20)
+
+/* Messages are a u32 length (host order, both ends are on this machine) and the bytes */
+struct SocketChannel : Channel
+{
+    int sock;
+
+    SocketChannel (int s) : sock(s) {}
+    ~SocketChannel () { close(sock); }
+
+    bool writeall (const char *p, size_t n)
+    {
+        while (n > 0)
+        {
+            ssize_t w = ::send(sock, p, n, MSG_NOSIGNAL);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) return false;
+            p += w;
+            n -= w;
+        }
+        return true;
+    }
+
+    bool readall (char *p, size_t n)
+    {
+        while (n > 0)
+        {
+            ssize_t r = ::recv(sock, p, n, 0);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) return false;
+            p += r;
+            n -= r;
+        }
+        return true;
+    }
+
+    bool send (const string &msg)
+    {
+        unsigned int len = msg.size();
+        return writeall((const char *)&len, sizeof(len)) && writeall(msg.data(), len);
+    }
+
+    bool recv (string &msg)
+    {
+        unsigned int len;
+        if (!readall((char *)&len, sizeof(len)) || len > MAX_MESSAGE) return false;
+        msg.resize(len);
+        return len == 0 || readall(&msg[0], len);
+    }
+
+    int fd () const { return sock; }
+};
+
+struct UnixTransport : Transport
+{
+    string path;
+    int listener;
+    pid_t owner;   // only the coordinator removes the socket file
+
+    UnixTransport (const string &p) : path(p), listener(-1), owner(getpid()) {}
+
+    ~UnixTransport ()
+    {
+        if (listener >= 0) close(listener);
+        if (listener >= 0 && getpid() == owner) unlink(path.c_str());
+    }
+
+    bool address (sockaddr_un &addr)
+    {
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path)) return false;
+        strcpy(addr.sun_path, path.c_str());
+        return true;
+    }
+
+    bool listen ()
+    {
+        sockaddr_un addr;
+        if (!address(addr)) return false;
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0) return false;
+        unlink(path.c_str());
+        return bind(listener, (sockaddr *)&addr, sizeof(addr)) == 0 && ::listen(listener, 64) == 0;
+    }
+
+    Channel *accept (int timeout_ms)
+    {
+        pollfd p = { listener, POLLIN, 0 };
+        if (poll(&p, 1, timeout_ms) <= 0) return NULL;
+        int s = ::accept(listener, NULL, NULL);
+        return s < 0 ? NULL : new SocketChannel(s);
+    }
+
+    Channel *connect ()
+    {
+        sockaddr_un addr;
+        if (!address(addr)) return NULL;
+        int s = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (s < 0) return NULL;
+        if (::connect(s, (sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            close(s);
+            return NULL;
+        }
+        return new SocketChannel(s);
+    }
+};
+
+Transport *unix_transport (const string &path)
+{
+    return new UnixTransport(path);
+}
+
+/* A worker process as the coordinator sees it */
+struct FarmWorker
+{
+    pid_t pid;
+    Channel *ch;
+    long job;   // job in flight, -1 if idle
+    chrono::steady_clock::time_point sent;   // when job was handed out
+    bool killed;                              // over time, waiting for its hangup
+};
+
+/* Worker side: answer jobs until the coordinator hangs up */
+static void serve (Transport &transport, const function<string (size_t)> &work)
+{
+    Channel *ch = transport.connect();
+    if (!ch) _exit(1);
+    string msg;
+    while (ch->recv(msg))
+    {
+        size_t job = strtoull(msg.c_str(), NULL, 10);
+        if (!ch->send(msg + " " + work(job))) break;
+    }
+    delete ch;
+    _exit(0);
+}
+
+static bool spawn (Transport &transport, const function<string (size_t)> &work,
+                   const vector<FarmWorker> &workers, FarmWorker &w)
+{
+    fflush(NULL);   // do not let the child flush our buffered output again
+    w.pid = fork();
+    if (w.pid < 0) return false;
+    if (w.pid == 0)
+    {
+        // Holding the other workers' sockets open would hide their hangup
+        for (size_t k=0; k<workers.size(); k++) close(workers[k].ch->fd());
+        serve(transport, work);
+    }
+
+    w.job = -1;
+    w.killed = false;
+    w.ch = transport.accept(10000);
+    if (w.ch) return true;
+    kill(w.pid, SIGKILL);
+    waitpid(w.pid, NULL, 0);
+    return false;
+}
+
+bool farm_run (Transport &transport, size_t njobs, int nworkers, int timeout_ms,
+               const function<string (size_t)> &work,
+               vector<string> &results, vector<int> &status)
+{
+    results.assign(njobs, string());
+    status.assign(njobs, FARM_NOT_RUN);
+    if (!transport.listen())
+    {
+        fprintf(stderr, "Cannot listen for farm workers\n");
+        return false;
+    }
+    if (nworkers < 1) nworkers = 1;
+
+    deque<size_t> pending;
+    for (size_t j=0; j<njobs; j++) pending.push_back(j);
+    vector<int> tries(njobs, 0);
+    size_t settled = 0;
+    int spawns = 0, maxspawns = nworkers * (FARM_RETRIES + 1);
+
+    vector<FarmWorker> workers;
+    for (int k=0; k<nworkers && k<(int)njobs; k++)
+    {
+        FarmWorker w;
+        spawns++;
+        if (spawn(transport, work, workers, w)) workers.push_back(w);
+    }
+
+    while (settled < njobs && !workers.empty())
+    {
+        // Hand out work to idle workers
+        for (size_t k=0; k<workers.size(); k++)
+        {
+            if (workers[k].job >= 0 || workers[k].killed || pending.empty()) continue;
+            workers[k].job = pending.front();
+            pending.pop_front();
+            workers[k].sent = chrono::steady_clock::now();
+            workers[k].ch->send(to_string(workers[k].job));
+        }
+
+        // Sleep until a reply, a hangup or the nearest job deadline
+        int wait = -1;
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        for (size_t k=0; k<workers.size() && timeout_ms > 0; k++)
+        {
+            if (workers[k].job < 0 || workers[k].killed) continue;
+            long spent = chrono::duration_cast<chrono::milliseconds>(now - workers[k].sent).count();
+            int left = spent >= timeout_ms ? 0 : timeout_ms - spent;
+            wait = wait < 0 ? left : min(wait, left);
+        }
+
+        vector<pollfd> fds(workers.size());
+        for (size_t k=0; k<workers.size(); k++)
+        {
+            fds[k].fd = workers[k].ch->fd();
+            fds[k].events = POLLIN;
+            fds[k].revents = 0;
+        }
+        if (poll(&fds[0], fds.size(), wait) < 0 && errno != EINTR) break;
+
+        // Kill workers past their deadline; their hangup is handled below,
+        // now or on the next round, and retries the job
+        now = chrono::steady_clock::now();
+        for (size_t k=0; k<workers.size() && timeout_ms > 0; k++)
+        {
+            FarmWorker &w = workers[k];
+            if (w.job < 0 || w.killed || now - w.sent < chrono::milliseconds(timeout_ms)) continue;
+            fprintf(stderr, "farm: job %ld timed out after %d ms, killing worker %d\n", w.job, timeout_ms, (int)w.pid);
+            kill(w.pid, SIGKILL);
+            w.killed = true;
+        }
+
+        for (size_t k = workers.size(); k-- > 0; )
+        {
+            if (!fds[k].revents) continue;
+            FarmWorker &w = workers[k];
+            string msg;
+            if (w.ch->recv(msg))
+            {
+                // "<job> <result>"
+                size_t sp = msg.find(' ');
+                size_t job = strtoull(msg.c_str(), NULL, 10);
+                if (sp != string::npos && (long)job == w.job && status[job] != FARM_DONE)
+                {
+                    results[job] = msg.substr(sp + 1);
+                    status[job] = FARM_DONE;
+                    settled++;
+                }
+                w.job = -1;
+                continue;
+            }
+
+            // The worker is gone: retry its job elsewhere and replace it
+            int wstatus;
+            delete w.ch;
+            waitpid(w.pid, &wstatus, 0);
+            if (w.job >= 0)
+            {
+                if (!w.killed) fprintf(stderr, "farm: worker %d died on job %ld\n", (int)w.pid, w.job);
+                status[w.job] = w.killed ? FARM_TIMEOUT : FARM_CRASHED;
+                if (++tries[w.job] < FARM_RETRIES) pending.push_back(w.job);
+                else settled++;
+            }
+            workers.erase(workers.begin() + k);
+            if (!pending.empty() && spawns < maxspawns)
+            {
+                FarmWorker nw;
+                spawns++;
+                if (spawn(transport, work, workers, nw)) workers.push_back(nw);
+            }
+        }
+    }
+
+    // Hanging up tells the workers to exit
+    for (size_t k=0; k<workers.size(); k++)
+    {
+        delete workers[k].ch;
+        waitpid(workers[k].pid, NULL, 0);
+    }
+    return true;
+}
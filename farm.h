@@ -0,0 +1,53 @@
+#ifndef FARM_H
+#define FARM_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/* A local solver farm: a coordinator hands jobs to forked worker processes,
+   one job at a time over a message channel, and collects the results. A
+   worker that crashes only loses its current job, which is retried on
+   another worker. The channel sits behind Transport so the same coordinator
+   can later reach workers on other hosts. */
+
+/* Times a job is tried before it is given up */
+#define FARM_RETRIES 3
+
+/* A connected, message-framed, bidirectional channel */
+struct Channel
+{
+    virtual ~Channel () {}
+    virtual bool send (const std::string &msg) = 0;
+    virtual bool recv (std::string &msg) = 0;   // false on error or when the peer is gone
+    virtual int fd () const = 0;                // for poll()
+};
+
+/* How the coordinator and its workers find each other */
+struct Transport
+{
+    virtual ~Transport () {}
+    virtual bool listen () = 0;                       // coordinator, once
+    virtual Channel *accept (int timeout_ms) = 0;     // coordinator, NULL on timeout or error
+    virtual Channel *connect () = 0;                  // worker, NULL on error
+};
+
+/* Unix domain stream sockets at path; the socket file is removed on delete */
+Transport *unix_transport (const std::string &path);
+
+/* How a job ended; FARM_NOT_RUN if no worker was left to take it */
+enum { FARM_DONE, FARM_CRASHED, FARM_TIMEOUT, FARM_NOT_RUN };
+
+/* Run jobs 0..njobs-1 on nworkers worker processes forked from here. work()
+   runs in a worker and returns the job's result, which lands in results[job]
+   with status[job] FARM_DONE. A worker still on one job after timeout_ms
+   (no limit if 0) is killed, and the job is retried like one whose worker
+   crashed. Jobs that failed FARM_RETRIES times are left FARM_CRASHED or
+   FARM_TIMEOUT, after how the last try ended, and jobs still queued once
+   workers could no longer be replaced FARM_NOT_RUN. Returns false if the
+   transport could not be set up. */
+bool farm_run (Transport &transport, size_t njobs, int nworkers, int timeout_ms,
+               const std::function<std::string (size_t)> &work,
+               std::vector<std::string> &results, std::vector<int> &status);
+
+#endif
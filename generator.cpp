@@ -0,0 +1,247 @@
+#include <stdlib.h>
+
+#include "distfield.h"
+#include "generator.h"
+#include "resolve.h"
+
+using namespace std;
+
+/* splitmix64: small, seedable and good enough for board layouts */
+static unsigned long long rnd (unsigned long long &s)
+{
+    unsigned long long z = (s += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static int rndint (unsigned long long &s, int n)
+{
+    return rnd(s) % n;
+}
+
+void generator_defaults (GenParams &p)
+{
+    p.rows = 12;
+    p.cols = 12;
+    p.minmoves = 15;
+    p.maxmoves = 40;
+    p.minbranch = 0;
+    p.maxbranch = NUM_MOVES;
+    p.maxgroups = 2;
+    p.mutations = 2000;
+    p.check = false;
+}
+
+void level_difficulty (const LevelData &data, GenStats &stats)
+{
+    const StateGraph &g = data.graph;
+    size_t moves = 0;
+    for (size_t e=0; e<g.next.size(); e++)
+        if (g.next[e] != TRANS_FALL) moves++;
+
+    stats.moves = data.optimal;
+    stats.states = g.states.size();
+    stats.branch = stats.states ? (double)moves / stats.states : 0;
+}
+
+/* A random walk of floor from the start, and a goal away from it */
+static void carve (Level &level, const GenParams &p, unsigned long long &seed)
+{
+    level.rows = p.rows;
+    level.cols = p.cols;
+    level.startx = 1 + rndint(seed, p.rows - 2);
+    level.starty = 1 + rndint(seed, p.cols - 2);
+    level.map.clear();
+
+    int x = level.startx, y = level.starty;
+    for (int n = p.rows * p.cols / 2; n > 0; n--)
+    {
+        level.set(x, y, TILE_FLOOR);
+        int d = rndint(seed, 4);
+        int nx = x + (d == 0) - (d == 1), ny = y + (d == 2) - (d == 3);
+        if (nx >= 0 && ny >= 0 && nx < p.rows && ny < p.cols)
+        {
+            x = nx;
+            y = ny;
+        }
+    }
+
+    // The farthest of a few random floor cells
+    int gx = x, gy = y, best = -1;
+    for (int t=0; t<32; t++)
+    {
+        int i = rndint(seed, p.rows), j = rndint(seed, p.cols);
+        int d = abs(i - level.startx) + abs(j - level.starty);
+        if (level.at(i, j) == TILE_FLOOR && d > best)
+        {
+            gx = i;
+            gy = j;
+            best = d;
+        }
+    }
+    if (gx == level.startx && gy == level.starty) gx = level.startx + 1;
+    level.set(gx, gy, TILE_GOAL);
+    board_prepare(level);
+}
+
+/* A cell as it was before a mutation */
+struct CellEdit
+{
+    int i, j;
+    short tile;
+    int group;
+};
+
+static void remember (const Level &level, int i, int j, vector<CellEdit> &undo)
+{
+    CellEdit e = { i, j, level.at(i, j), level.groupat(i, j) };
+    undo.push_back(e);
+}
+
+/* One random change to the tiles, with the old cells in undo.
+   Returns false if it did nothing. */
+static bool mutate (Level &level, const GenParams &p, unsigned long long &seed, vector<CellEdit> &undo)
+{
+    int i = rndint(seed, p.rows), j = rndint(seed, p.cols);
+    undo.clear();
+    if (i == level.startx && j == level.starty) return false;
+    short t = level.at(i, j);
+    remember(level, i, j, undo);
+
+    switch (rndint(seed, 4))
+    {
+    case 0:  // open or close a cell
+        if (t == TILE_VOID) level.set(i, j, TILE_FLOOR);
+        else if (t == TILE_FLOOR || t == TILE_FRAGILE) level.set(i, j, TILE_VOID);
+        else return false;
+        break;
+    case 1:  // fragile tile
+        if (t == TILE_FLOOR) level.set(i, j, TILE_FRAGILE);
+        else if (t == TILE_FRAGILE) level.set(i, j, TILE_FLOOR);
+        else return false;
+        break;
+    case 2:  // a bridge over a gap and a switch somewhere on the floor
+    {
+        if (t != TILE_VOID || level.ngroups >= p.maxgroups) return false;
+        int si = rndint(seed, p.rows), sj = rndint(seed, p.cols);
+        if (level.at(si, sj) != TILE_FLOOR || (si == level.startx && sj == level.starty)) return false;
+        int g = level.ngroups;
+        remember(level, si, sj, undo);
+        level.set(i, j, TILE_BRIDGE);
+        level.setgroup(i, j, g);
+        level.set(si, sj, TILE_SWITCH);
+        level.setgroup(si, sj, g);
+        break;
+    }
+    default:  // move the goal onto a floor cell
+        if (t != TILE_FLOOR) return false;
+        for (int gi=0; gi<p.rows; gi++)
+            for (int gj=0; gj<p.cols; gj++)
+                if (level.at(gi, gj) == TILE_GOAL)
+                {
+                    remember(level, gi, gj, undo);
+                    level.set(gi, gj, TILE_FLOOR);
+                }
+        level.set(i, j, TILE_GOAL);
+        break;
+    }
+    board_prepare(level);
+    return true;
+}
+
+/* States of a fresh solve of data's level whose distance or hint the
+   field, kept up to date by resolve_update() and field_refresh(), gets wrong */
+static size_t fieldmismatches (const LevelData &data, const DistanceField &field)
+{
+    LevelData fresh;
+    fresh.level = data.level;
+    level_precompute(fresh);
+
+    size_t bad = 0;
+    for (size_t s=0; s<fresh.graph.states.size(); s++)
+    {
+        const State &st = fresh.graph.states[s];
+        int d = fresh.graph.dist[s];
+        bool ok = field_distance(field, st) == d;
+
+        // The hint has to take one step down the fresh distances
+        char h = field_hint(field, st);
+        if (ok && d > 0)
+        {
+            ok = false;
+            for (int m=0; m<NUM_MOVES; m++)
+            {
+                if (board_moves[m] != h) continue;
+                unsigned int t = fresh.graph.next[s*NUM_MOVES + m];
+                ok = t == TRANS_GOAL || (t != TRANS_FALL && fresh.graph.dist[t] == d - 1);
+            }
+        }
+        else if (ok) ok = h == 0 || d == 0;
+        bad += !ok;
+    }
+    return bad;
+}
+
+static bool inbounds (const GenParams &p, const GenStats &s)
+{
+    return s.moves >= p.minmoves && s.moves <= p.maxmoves &&
+           s.branch >= p.minbranch && s.branch <= p.maxbranch;
+}
+
+bool generate_level (const GenParams &p, unsigned long long seed, LevelData &out, GenStats &stats)
+{
+    LevelData cur;
+    ResolveCache cache;
+    DistanceField field;
+    vector<CellEdit> undo;
+    vector<pair<int,int> > cells;
+    carve(cur.level, p, seed);
+    level_precompute(cur);
+    resolve_init(cur, cache);
+    field_build(cur, field);
+    level_difficulty(cur, stats);
+    stats.mismatches = 0;
+
+    for (int m=0; m<p.mutations && !inbounds(p, stats); m++)
+    {
+        if (!mutate(cur.level, p, seed, undo)) continue;
+        board_prepare(cur.level);
+        cells.clear();
+        for (size_t k=0; k<undo.size(); k++) cells.push_back(make_pair(undo[k].i, undo[k].j));
+
+        // Repair the distances rather than solving again, and the field over them
+        resolve_update(cur, cache, cells);
+        field_refresh(field);
+        int moves = field_distance(field, board_start(cur.level));
+        if (p.check) stats.mismatches += fieldmismatches(cur, field);
+
+        // Climb towards longer solutions without overshooting the bound
+        if (moves < 0 || moves > p.maxmoves || moves < stats.moves)
+        {
+            for (size_t k = undo.size(); k-- > 0; )
+            {
+                cur.level.set(undo[k].i, undo[k].j, undo[k].tile);
+                cur.level.setgroup(undo[k].i, undo[k].j, undo[k].group);
+            }
+            board_prepare(cur.level);
+            resolve_update(cur, cache, cells);
+            field_refresh(field);
+            continue;
+        }
+        stats.moves = moves;
+
+        // Long enough: the branching factor needs a clean graph of reachable states
+        if (moves >= p.minmoves)
+        {
+            level_precompute(cur);
+            resolve_init(cur, cache);
+            field_build(cur, field);
+            level_difficulty(cur, stats);
+        }
+    }
+
+    if (!inbounds(p, stats)) return false;
+    out = cur;
+    return true;
+}
@@ -0,0 +1,39 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include "levelpack.h"
+
+/* Procedural levels by mutate-and-validate: carve a random floor, then keep
+   applying small mutations (floor/void, fragile tiles, switch and bridge
+   pairs, moving the goal) while the level stays solvable and its optimal
+   solution does not get shorter, until it lands inside the bounds. */
+
+struct GenParams
+{
+    int rows, cols;
+    int minmoves, maxmoves;          // optimal solution length
+    double minbranch, maxbranch;     // mean non-fatal moves per reachable state
+    int maxgroups;                   // switch/bridge groups to add at most
+    int mutations;                   // mutations tried per candidate
+    bool check;                      // compare each repaired distance field with a fresh solve (slow)
+};
+
+/* Difficulty measures of a level with its metadata */
+struct GenStats
+{
+    int moves;        // optimal move count, -1 if unsolvable
+    double branch;    // branching factor
+    size_t states;    // reachable states
+    size_t mismatches;   // with p.check, states the repaired field got wrong
+};
+
+void generator_defaults (GenParams &p);
+
+/* Fill stats from data.graph (level_precompute() must have run) */
+void level_difficulty (const LevelData &data, GenStats &stats);
+
+/* Grow one candidate from seed. Returns true with the level and its
+   metadata in out if it met the bounds within p.mutations tries. */
+bool generate_level (const GenParams &p, unsigned long long seed, LevelData &out, GenStats &stats);
+
+#endif
@@ -0,0 +1,68 @@
+/* levelc - compile text level sources into a level pack
+ *
+ *   levelc -o levels.pack levels/level1.lvl levels/level2.lvl ...
+ *
+ * Every level is solved here, so the pack carries the optimal move count,
+ * the reachable states, their transitions and their goal distances.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "levelpack.h"
+
+using namespace std;
+
+static void usage ()
+{
+    fprintf(stderr, "usage: levelc [-o out.pack] [--no-meta] level.lvl ...\n");
+}
+
+int main (int argc, char **argv)
+{
+    const char *out = "levels.pack";
+    bool meta = true;
+    vector<const char *> sources;
+
+    for (int a=1; a<argc; a++)
+    {
+        if (!strcmp(argv[a], "-o") && a+1 < argc) out = argv[++a];
+        else if (!strcmp(argv[a], "--no-meta")) meta = false;
+        else if (argv[a][0] == '-') { usage(); return 2; }
+        else sources.push_back(argv[a]);
+    }
+    if (sources.empty())
+    {
+        usage();
+        return 2;
+    }
+
+    vector<LevelData> levels(sources.size());
+    for (size_t l=0; l<sources.size(); l++)
+    {
+        string err;
+        if (!level_parse(sources[l], levels[l].level, err))
+        {
+            fprintf(stderr, "%s\n", err.c_str());
+            return 1;
+        }
+        levels[l].hasmeta = false;
+        levels[l].optimal = -1;
+        if (!meta) continue;
+
+        level_precompute(levels[l]);
+        // Dead ends: reachable states the goal cannot be reached from, where the game offers a restart
+        unsigned int dead = 0;
+        for (size_t s=0; s<levels[l].graph.dist.size(); s++) dead += levels[l].graph.dist[s] < 0;
+        printf("%s: %s, %d moves, %u states, %u dead ends\n", sources[l], levels[l].level.name.c_str(),
+               levels[l].optimal, (unsigned int)levels[l].graph.states.size(), dead);
+        if (levels[l].optimal < 0)
+            fprintf(stderr, "%s: warning: level cannot be solved\n", sources[l]);
+    }
+
+    if (!pack_write(out, levels)) return 1;
+    printf("Wrote %u levels to %s\n", (unsigned int)levels.size(), out);
+    return 0;
+}
@@ -0,0 +1,126 @@
+/* levelgen - generate random levels into a level pack
+ *
+ *   levelgen -o generated.pack -n 100 --moves 20-40 --branch 1.5-2.5
+ *
+ * Candidates are grown on every core, each from its own seed, and only
+ * those whose optimal solution and branching factor fall within the bounds
+ * are kept. The pack carries the same metadata as levelc output.
+ *
+ * With --check every incremental repair of the distances is compared with
+ * a fresh solve, and any disagreement fails the run.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "generator.h"
+
+using namespace std;
+
+static void usage ()
+{
+    fprintf(stderr, "usage: levelgen [-o out.pack] [-n count] [--size RxC] [--moves MIN-MAX]\n"
+                    "                [--branch MIN-MAX] [--groups N] [--mutations N]\n"
+                    "                [--threads N] [--seed S] [--check]\n");
+}
+
+int main (int argc, char **argv)
+{
+    const char *out = "generated.pack";
+    int count = 10;
+    int nthreads = thread::hardware_concurrency();
+    unsigned long long seed = 1;
+    GenParams p;
+    generator_defaults(p);
+
+    for (int a=1; a<argc; a++)
+    {
+        bool ok = true;
+        if (!strcmp(argv[a], "-o") && a+1 < argc) out = argv[++a];
+        else if (!strcmp(argv[a], "-n") && a+1 < argc) count = atoi(argv[++a]);
+        else if (!strcmp(argv[a], "--size") && a+1 < argc) ok = sscanf(argv[++a], "%dx%d", &p.rows, &p.cols) == 2;
+        else if (!strcmp(argv[a], "--moves") && a+1 < argc) ok = sscanf(argv[++a], "%d-%d", &p.minmoves, &p.maxmoves) == 2;
+        else if (!strcmp(argv[a], "--branch") && a+1 < argc) ok = sscanf(argv[++a], "%lf-%lf", &p.minbranch, &p.maxbranch) == 2;
+        else if (!strcmp(argv[a], "--groups") && a+1 < argc) p.maxgroups = atoi(argv[++a]);
+        else if (!strcmp(argv[a], "--mutations") && a+1 < argc) p.mutations = atoi(argv[++a]);
+        else if (!strcmp(argv[a], "--threads") && a+1 < argc) nthreads = atoi(argv[++a]);
+        else if (!strcmp(argv[a], "--seed") && a+1 < argc) seed = strtoull(argv[++a], NULL, 10);
+        else if (!strcmp(argv[a], "--check")) p.check = true;
+        else ok = false;
+        if (!ok) { usage(); return 2; }
+    }
+    if (count < 1 || p.rows < 3 || p.cols < 3 || p.maxgroups > MAX_GROUPS || p.minmoves > p.maxmoves)
+    {
+        usage();
+        return 2;
+    }
+    if (nthreads < 1) nthreads = 1;
+
+    // Workers claim candidate numbers until enough levels are kept
+    vector<pair<unsigned long long, LevelData> > kept;
+    mutex lock;
+    atomic<unsigned long long> next(0);
+    atomic<int> nkept(0);
+    atomic<size_t> mismatches(0);
+    unsigned long long limit = (unsigned long long)count * 1000;
+
+    auto worker = [&] ()
+    {
+        while (nkept.load() < count)
+        {
+            unsigned long long n = next++;
+            if (n >= limit) break;
+
+            LevelData data;
+            GenStats stats;
+            bool good = generate_level(p, seed * 0x100000001b3ULL + n, data, stats);
+            if (stats.mismatches)
+            {
+                fprintf(stderr, "candidate %llu: %u states with repaired distances that differ from a fresh solve\n",
+                        n, (unsigned int)stats.mismatches);
+                mismatches += stats.mismatches;
+            }
+            if (!good) continue;
+
+            lock_guard<mutex> guard(lock);
+            printf("candidate %llu: %d moves, branching %.2f, %u states\n",
+                   n, stats.moves, stats.branch, (unsigned int)stats.states);
+            kept.push_back(make_pair(n, data));
+            nkept++;
+        }
+    };
+
+    vector<thread> threads;
+    for (int t=1; t<nthreads; t++) threads.push_back(thread(worker));
+    worker();
+    for (size_t t=0; t<threads.size(); t++) threads[t].join();
+
+    // Same seed, same pack: order by candidate number and drop the extras
+    sort(kept.begin(), kept.end(),
+         [] (const pair<unsigned long long, LevelData> &a, const pair<unsigned long long, LevelData> &b)
+         { return a.first < b.first; });
+    if (kept.size() > (size_t)count) kept.resize(count);
+    if ((int)kept.size() < count)
+        fprintf(stderr, "warning: only %u of %d levels met the bounds in %llu candidates\n",
+                (unsigned int)kept.size(), count, limit);
+
+    vector<LevelData> levels;
+    for (size_t l=0; l<kept.size(); l++)
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "Generated %llu", kept[l].first);
+        kept[l].second.level.name = name;
+        levels.push_back(kept[l].second);
+    }
+    if (levels.empty() || !pack_write(out, levels)) return 1;
+    printf("Wrote %u levels to %s\n", (unsigned int)levels.size(), out);
+    if (p.check) printf("Repair check: %u mismatched states\n", (unsigned int)mismatches.load());
+    return mismatches.load() ? 1 : 0;
+}
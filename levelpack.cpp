@@ -0,0 +1,418 @@
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+
+#include "levelpack.h"
+
+using namespace std;
+
+bool level_parse (const char *path, Level &level, string &err)
+{
+    ifstream in(path);
+    if (!in.is_open())
+    {
+        err = string("cannot open ") + path;
+        return false;
+    }
+
+    vector<short> cells;
+    vector<int> groups;  // (group, i, j) triples
+    int rows = 0, cols = 0, startx = 1, starty = 1;
+    string name = path, line;
+    for (int lineno = 1; getline(in, line); lineno++)
+    {
+        if (!line.empty() && line[line.size()-1] == '\r') line.erase(line.size()-1);
+        if (line.empty() || line[0] == '#') continue;
+
+        if (line[0] >= '0' && line[0] <= '9')
+        {
+            if (cols == 0) cols = line.size();
+            if ((int)line.size() != cols)
+            {
+                err = string(path) + ":" + to_string(lineno) + ": row length differs from the first row";
+                return false;
+            }
+            for (size_t j=0; j<line.size(); j++)
+            {
+                if (line[j] < '0' || line[j] > '0' + TILE_GOAL)
+                {
+                    err = string(path) + ":" + to_string(lineno) + ": bad tile '" + line[j] + "'";
+                    return false;
+                }
+                cells.push_back(line[j] - '0');
+            }
+            rows++;
+            continue;
+        }
+
+        istringstream words(line);
+        string key;
+        words >> key;
+        if (key == "name")
+        {
+            getline(words >> ws, name);
+        }
+        else if (key == "start")
+        {
+            if (!(words >> startx >> starty))
+            {
+                err = string(path) + ":" + to_string(lineno) + ": start needs two numbers";
+                return false;
+            }
+        }
+        else if (key == "group")
+        {
+            int g, i, j;
+            if (!(words >> g >> i >> j) || g < 0 || g >= MAX_GROUPS)
+            {
+                err = string(path) + ":" + to_string(lineno) + ": group needs a group below " + to_string(MAX_GROUPS) + " and a cell";
+                return false;
+            }
+            groups.push_back(g);
+            groups.push_back(i);
+            groups.push_back(j);
+        }
+        else
+        {
+            err = string(path) + ":" + to_string(lineno) + ": unknown directive '" + key + "'";
+            return false;
+        }
+    }
+
+    if (rows == 0)
+    {
+        err = string(path) + ": no grid";
+        return false;
+    }
+    if (startx < 0 || starty < 0 || startx >= rows || starty >= cols)
+    {
+        err = string(path) + ": start is outside the grid";
+        return false;
+    }
+
+    board_init(level, name.c_str(), rows, cols, &cells[0], startx, starty);
+    for (size_t k=0; k<groups.size(); k += 3)
+    {
+        short v = level.at(groups[k+1], groups[k+2]);
+        if (v != TILE_SWITCH && v != TILE_BRIDGE)
+        {
+            err = string(path) + ": group " + to_string(groups[k]) + " names (" + to_string(groups[k+1]) + "," +
+                  to_string(groups[k+2]) + "), which is not a switch or bridge";
+            return false;
+        }
+        level.setgroup(groups[k+1], groups[k+2], groups[k]);
+    }
+    board_prepare(level);
+    return true;
+}
+
+void level_precompute (LevelData &data)
+{
+    solver_explore(data.level, data.graph);
+    data.optimal = data.graph.dist[0];
+    data.hasmeta = true;
+}
+
+/* Little endian writers into a byte buffer */
+static void put32 (string &b, unsigned int v)
+{
+    for (int k=0; k<4; k++) b += (char)(v >> (8*k));
+}
+
+static void put16 (string &b, unsigned int v)
+{
+    b += (char)v;
+    b += (char)(v >> 8);
+}
+
+static void put64 (string &b, unsigned long long v)
+{
+    put32(b, (unsigned int)v);
+    put32(b, (unsigned int)(v >> 32));
+}
+
+static void putchunk (string &b, const char *tag, const string &payload)
+{
+    b.append(tag, 4);
+    put32(b, payload.size());
+    b += payload;
+}
+
+bool pack_write (const char *path, const vector<LevelData> &levels)
+{
+    string out = "TBZP";
+    put32(out, PACK_VERSION);
+    put32(out, levels.size());
+
+    for (size_t l=0; l<levels.size(); l++)
+    {
+        const LevelData &d = levels[l];
+        const Level &lv = d.level;
+        string body, c;
+
+        put32(c, lv.rows);
+        put32(c, lv.cols);
+        put32(c, lv.startx);
+        put32(c, lv.starty);
+        put32(c, lv.name.size());
+        c += lv.name;
+        putchunk(body, "INFO", c);
+
+        c.clear();
+        put32(c, lv.map.chunks.size());
+        for (size_t n=0; n<lv.map.chunks.size(); n++)
+        {
+            const Chunk &ch = lv.map.chunks[n];
+            put32(c, ch.cx);
+            put32(c, ch.cy);
+            c.append((const char *)ch.tile, CHUNK*CHUNK);
+            c.append((const char *)ch.group, CHUNK*CHUNK);
+        }
+        putchunk(body, "CHNK", c);
+
+        if (d.hasmeta)
+        {
+            const StateGraph &g = d.graph;
+            c.clear();
+            put32(c, d.optimal);
+            put32(c, g.states.size());
+            putchunk(body, "META", c);
+
+            c.clear();
+            for (size_t s=0; s<g.states.size(); s++)
+            {
+                put16(c, g.states[s].x);
+                put16(c, g.states[s].y);
+                c += (char)g.states[s].orientation;
+                c += (char)0;
+                put32(c, g.states[s].bridges);
+                put64(c, g.states[s].fallen);
+            }
+            putchunk(body, "STAT", c);
+
+            c.clear();
+            for (size_t e=0; e<g.next.size(); e++) put32(c, g.next[e]);
+            putchunk(body, "TRAN", c);
+
+            c.clear();
+            for (size_t s=0; s<g.dist.size(); s++) put32(c, g.dist[s]);
+            putchunk(body, "DIST", c);
+        }
+
+        putchunk(out, "LEVL", body);
+    }
+
+    FILE *f = fopen(path, "wb");
+    if (!f)
+    {
+        perror(path);
+        return false;
+    }
+    bool ok = fwrite(out.data(), 1, out.size(), f) == out.size();
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) fprintf(stderr, "%s: write failed\n", path);
+    return ok;
+}
+
+/* Bounds checked little endian reader over a loaded pack */
+struct Reader
+{
+    const unsigned char *p, *end;
+
+    bool has (size_t n) const { return (size_t)(end - p) >= n; }
+    unsigned int u32 () { unsigned int v = p[0] | p[1] << 8 | p[2] << 16 | (unsigned int)p[3] << 24; p += 4; return v; }
+    short i16 () { short v = (short)(p[0] | p[1] << 8); p += 2; return v; }
+    unsigned long long u64 () { unsigned long long lo = u32(); return lo | (unsigned long long)u32() << 32; }
+};
+
+static bool read_level (Reader r, LevelData &d)
+{
+    Level &lv = d.level;
+    bool info = false, grid = false;
+    unsigned int nstates = 0;
+    d.hasmeta = false;
+    d.optimal = -1;
+    lv.map.clear();
+
+    while (r.has(8))
+    {
+        char tag[4];
+        memcpy(tag, r.p, 4);
+        r.p += 4;
+        unsigned int size = r.u32();
+        if (!r.has(size)) return false;
+        Reader c = { r.p, r.p + size };
+        r.p += size;
+
+        if (!memcmp(tag, "INFO", 4))
+        {
+            if (!c.has(20)) return false;
+            lv.rows = c.u32();
+            lv.cols = c.u32();
+            lv.startx = (int)c.u32();
+            lv.starty = (int)c.u32();
+            unsigned int len = c.u32();
+            // As level_parse(), the start has to be on the grid
+            if (!c.has(len) || lv.rows <= 0 || lv.cols <= 0) return false;
+            if (lv.startx < 0 || lv.starty < 0 || lv.startx >= lv.rows || lv.starty >= lv.cols) return false;
+            lv.name.assign((const char *)c.p, len);
+            info = true;
+        }
+        else if (!memcmp(tag, "GRID", 4))
+        {
+            // Dense grid of version 1 and 2 packs
+            if (!info || size != (unsigned int)(lv.rows*lv.cols)) return false;
+            lv.map.clear();
+            for (int i=0; i<lv.rows; i++)
+                for (int j=0; j<lv.cols; j++)
+                    lv.set(i, j, c.p[i*lv.cols + j]);
+            board_prepare(lv);
+            grid = true;
+        }
+        else if (!memcmp(tag, "GRPS", 4))
+        {
+            if (!grid || size != (unsigned int)(lv.rows*lv.cols)) return false;
+            for (int i=0; i<lv.rows; i++)
+                for (int j=0; j<lv.cols; j++)
+                {
+                    if (c.p[i*lv.cols + j] >= MAX_GROUPS) return false;
+                    lv.setgroup(i, j, c.p[i*lv.cols + j]);
+                }
+            board_prepare(lv);
+        }
+        else if (!memcmp(tag, "CHNK", 4))
+        {
+            if (!info || !c.has(4)) return false;
+            // Bound the count first so the size check below cannot wrap
+            unsigned int nchunks = c.u32();
+            if (nchunks > (size - 4) / (8 + 2*CHUNK*CHUNK) || size != 4 + nchunks * (8 + 2*CHUNK*CHUNK)) return false;
+            lv.map.clear();
+            for (unsigned int n=0; n<nchunks; n++)
+            {
+                if (!c.has(8 + 2*CHUNK*CHUNK)) return false;
+                int cx = (int)c.u32(), cy = (int)c.u32();
+                const unsigned char *tiles = c.p, *grps = c.p + CHUNK*CHUNK;
+                c.p += 2*CHUNK*CHUNK;
+                if (lv.map.find(cx, cy)) return false;
+                Chunk *ch = lv.map.insert(cx, cy);
+                for (int k=0; k<CHUNK*CHUNK; k++)
+                {
+                    if (tiles[k] > TILE_GOAL || grps[k] >= MAX_GROUPS) return false;
+                    ch->tile[k] = tiles[k];
+                    ch->group[k] = grps[k];
+                    ch->count += tiles[k] != TILE_VOID;
+                }
+            }
+            board_prepare(lv);
+            grid = true;
+        }
+        else if (!memcmp(tag, "META", 4))
+        {
+            if (!c.has(8)) return false;
+            d.optimal = (int)c.u32();
+            nstates = c.u32();
+            d.hasmeta = true;
+        }
+        else if (!memcmp(tag, "STAT", 4))
+        {
+            if (nstates > size / 18 || size != nstates * 18) return false;
+            d.graph.states.resize(nstates);
+            for (unsigned int s=0; s<nstates; s++)
+            {
+                State &st = d.graph.states[s];
+                st.x = c.i16();
+                st.y = c.i16();
+                st.orientation = c.p[0];
+                c.p += 2;
+                st.bridges = c.u32();
+                st.fallen = c.u64();
+            }
+        }
+        else if (!memcmp(tag, "TRAN", 4))
+        {
+            if (nstates > size / (NUM_MOVES * 4) || size != nstates * NUM_MOVES * 4) return false;
+            d.graph.next.resize(nstates * NUM_MOVES);
+            for (size_t e=0; e<d.graph.next.size(); e++) d.graph.next[e] = c.u32();
+        }
+        else if (!memcmp(tag, "DIST", 4))
+        {
+            if (nstates > size / 4 || size != nstates * 4) return false;
+            d.graph.dist.resize(nstates);
+            for (unsigned int s=0; s<nstates; s++) d.graph.dist[s] = (int)c.u32();
+        }
+    }
+
+    if (!info || !grid) return false;
+    if (d.hasmeta)
+    {
+        if (nstates == 0 || d.graph.states.size() != nstates || d.graph.next.size() != (size_t)nstates * NUM_MOVES ||
+            d.graph.dist.size() != nstates)
+            return false;
+
+        // The distance field indexes by these, so a corrupt pack must not get past here
+        for (unsigned int s=0; s<nstates; s++)
+        {
+            const State &st = d.graph.states[s];
+            if (st.x < 0 || st.y < 0 || st.x >= lv.rows || st.y >= lv.cols || st.orientation > ORIENT_LYING_X) return false;
+        }
+        for (size_t e=0; e<d.graph.next.size(); e++)
+        {
+            unsigned int t = d.graph.next[e];
+            if (t >= nstates && t != TRANS_FALL && t != TRANS_GOAL) return false;
+        }
+    }
+    return true;
+}
+
+bool pack_read (const char *path, vector<LevelData> &levels)
+{
+    ifstream in(path, ios::in | ios::binary);
+    if (!in.is_open()) return false;
+    string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+    Reader r = { (const unsigned char *)data.data(), (const unsigned char *)data.data() + data.size() };
+    if (!r.has(12) || memcmp(r.p, "TBZP", 4))
+    {
+        fprintf(stderr, "%s: not a level pack\n", path);
+        return false;
+    }
+    r.p += 4;
+    unsigned int version = r.u32();
+    if (version > PACK_VERSION)
+    {
+        fprintf(stderr, "%s: pack version %u is newer than supported (%d)\n", path, version, PACK_VERSION);
+        return false;
+    }
+    unsigned int nlevels = r.u32();
+    if (nlevels == 0)
+    {
+        fprintf(stderr, "%s: pack has no levels\n", path);
+        return false;
+    }
+
+    levels.clear();
+    while (r.has(8) && levels.size() < nlevels)
+    {
+        bool islevel = !memcmp(r.p, "LEVL", 4);
+        r.p += 4;
+        unsigned int size = r.u32();
+        if (!r.has(size)) break;
+        Reader body = { r.p, r.p + size };
+        r.p += size;
+        if (!islevel) continue;
+
+        levels.push_back(LevelData());
+        if (!read_level(body, levels.back()))
+        {
+            fprintf(stderr, "%s: level %u is corrupt\n", path, (unsigned int)levels.size());
+            return false;
+        }
+    }
+    if (levels.size() != nlevels)
+    {
+        fprintf(stderr, "%s: truncated pack\n", path);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,64 @@
+#ifndef LEVELPACK_H
+#define LEVELPACK_H
+
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "solver.h"
+
+/*
+ * Level sources are text files:
+ *
+ *   # comment
+ *   name First Steps
+ *   start 1 1
+ *   group 1 3 4
+ *   011110000000
+ *   ...
+ *
+ * Each digit row is one row of the grid (x), each column one y, using the
+ * TILE_* values. The start defaults to cell (1,1). "group G i j" puts the
+ * switch or bridge at (i,j) in group G; switches only lower the bridges of
+ * their own group, and everything not listed is in group 0.
+ *
+ * A level pack is a binary file of tagged chunks (little endian):
+ *
+ *   "TBZP" u32 version u32 nlevels, then per level "LEVL" u32 size holding
+ *   INFO  u32 rows, u32 cols, i32 startx, i32 starty, u32 namelen, name
+ *   CHNK  u32 nchunks, per chunk: i32 cx, i32 cy, CHUNK*CHUNK u8 tiles,
+ *         CHUNK*CHUNK u8 switch/bridge groups (only chunks with a tile)
+ *
+ * Version 1 and 2 packs hold a dense grid instead of CHNK:
+ *   GRID  rows*cols u8 tile values
+ *   GRPS  rows*cols u8 switch/bridge groups (absent if all are in group 0)
+ *
+ * and every version may add:
+ *   META  i32 optimal moves (-1 if unsolvable), u32 reachable states
+ *   STAT  per state: i16 x, i16 y, u8 orientation, u8 0, u32 bridges, u64 fallen
+ *   TRAN  per state: NUM_MOVES u32 successors (index, TRANS_FALL or TRANS_GOAL)
+ *   DIST  per state: i32 moves to the goal (-1 if unreachable)
+ *
+ * Readers skip chunks they do not know.
+ */
+
+#define PACK_VERSION 3
+
+struct LevelData
+{
+    Level level;
+    bool hasmeta;       // false if the pack only had the grid
+    int optimal;        // optimal move count, -1 if unsolvable
+    StateGraph graph;   // reachable states, transitions and goal distances
+};
+
+/* Parse a text level source. Returns false and fills err on failure. */
+bool level_parse (const char *path, Level &level, std::string &err);
+
+/* Run the solver over a parsed level and fill the metadata */
+void level_precompute (LevelData &data);
+
+bool pack_write (const char *path, const std::vector<LevelData> &levels);
+bool pack_read (const char *path, std::vector<LevelData> &levels);
+
+#endif
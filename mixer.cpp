@@ -0,0 +1,197 @@
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define MIX_X86
+#endif
+
+#include "mixer.h"
+
+/* The two 16-bit weights of a linear interpolation at fraction frac, low
+   word for the frame at or before the position */
+static inline unsigned int weights (unsigned int frac)
+{
+    unsigned int w = (frac & 0xffff) >> 2;
+    return w << 16 | (16384 - w);
+}
+
+static inline int interpolate (short a, short b, unsigned int ww)
+{
+    return (a * (int)(ww & 0xffff) + b * (int)(ww >> 16)) >> 14;
+}
+
+static void add_scalar (int *acc, const short *src, size_t n, int gain)
+{
+    for (size_t i=0; i<n; i++) acc[i] += src[i] * gain >> 14;
+}
+
+static void addresampled_scalar (int *acc, const short *src, unsigned int pos, unsigned int step, size_t n, int gain)
+{
+    for (size_t k=0; k<n; k++, pos += step)
+    {
+        const short *f = src + 2*(pos >> 16);
+        unsigned int ww = weights(pos);
+        acc[2*k] += interpolate(f[0], f[2], ww) * gain >> 14;
+        acc[2*k + 1] += interpolate(f[1], f[3], ww) * gain >> 14;
+    }
+}
+
+static void clamp_scalar (short *out, const int *acc, size_t n)
+{
+    for (size_t i=0; i<n; i++) out[i] = acc[i] > 32767 ? 32767 : acc[i] < -32768 ? -32768 : acc[i];
+}
+
+static const MixKernels scalar = { "scalar", add_scalar, addresampled_scalar, clamp_scalar };
+
+#ifdef MIX_X86
+
+/* Both 32-bit halves of a stereo frame at once */
+static inline int frame32 (const short *f)
+{
+    int v;
+    memcpy(&v, f, sizeof(v));
+    return v;
+}
+
+__attribute__((target("sse2")))
+static void add_sse2 (int *acc, const short *src, size_t n, int gain)
+{
+    __m128i g = _mm_set1_epi16(gain);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        // 16x16 products as 32 bits, from their low and high halves
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i lo = _mm_mullo_epi16(s, g), hi = _mm_mulhi_epi16(s, g);
+        __m128i p0 = _mm_srai_epi32(_mm_unpacklo_epi16(lo, hi), 14);
+        __m128i p1 = _mm_srai_epi32(_mm_unpackhi_epi16(lo, hi), 14);
+        _mm_storeu_si128((__m128i *)(acc + i), _mm_add_epi32(_mm_loadu_si128((__m128i *)(acc + i)), p0));
+        _mm_storeu_si128((__m128i *)(acc + i + 4), _mm_add_epi32(_mm_loadu_si128((__m128i *)(acc + i + 4)), p1));
+    }
+    add_scalar(acc + i, src + i, n - i, gain);
+}
+
+__attribute__((target("sse2")))
+static void addresampled_sse2 (int *acc, const short *src, unsigned int pos, unsigned int step, size_t n, int gain)
+{
+    size_t k = 0;
+    for (; k + 4 <= n; k += 4)
+    {
+        unsigned int p[4] = { pos, pos + step, pos + 2*step, pos + 3*step };
+        pos += 4*step;
+        const short *f0 = src + 2*(p[0] >> 16), *f1 = src + 2*(p[1] >> 16), *f2 = src + 2*(p[2] >> 16), *f3 = src + 2*(p[3] >> 16);
+
+        // (a, b) sample pairs against (1 - w, w) weight pairs: one madd interpolates
+        __m128i a = _mm_set_epi32(frame32(f3), frame32(f2), frame32(f1), frame32(f0));
+        __m128i b = _mm_set_epi32(frame32(f3 + 2), frame32(f2 + 2), frame32(f1 + 2), frame32(f0 + 2));
+        __m128i w = _mm_set_epi32(weights(p[3]), weights(p[2]), weights(p[1]), weights(p[0]));
+        __m128i v0 = _mm_srai_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(a, b), _mm_unpacklo_epi32(w, w)), 14);
+        __m128i v1 = _mm_srai_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(a, b), _mm_unpackhi_epi32(w, w)), 14);
+
+        // Interpolation stays in 16 bits, so apply the gain like add_sse2
+        short s[8];
+        _mm_storeu_si128((__m128i *)s, _mm_packs_epi32(v0, v1));
+        add_sse2(acc + 2*k, s, 8, gain);
+    }
+    addresampled_scalar(acc + 2*k, src, pos, step, n - k, gain);
+}
+
+__attribute__((target("sse2")))
+static void clamp_sse2 (short *out, const int *acc, size_t n)
+{
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i *)(acc + i)), b = _mm_loadu_si128((const __m128i *)(acc + i + 4));
+        _mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(a, b));
+    }
+    clamp_scalar(out + i, acc + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static void add_avx2 (int *acc, const short *src, size_t n, int gain)
+{
+    __m256i g = _mm256_set1_epi32(gain);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i s = _mm256_cvtepi16_epi32(_mm_loadu_si128((const __m128i *)(src + i)));
+        __m256i p = _mm256_srai_epi32(_mm256_mullo_epi32(s, g), 14);
+        _mm256_storeu_si256((__m256i *)(acc + i), _mm256_add_epi32(_mm256_loadu_si256((__m256i *)(acc + i)), p));
+    }
+    add_scalar(acc + i, src + i, n - i, gain);
+}
+
+__attribute__((target("avx2")))
+static void addresampled_avx2 (int *acc, const short *src, unsigned int pos, unsigned int step, size_t n, int gain)
+{
+    __m256i g = _mm256_set1_epi32(gain);
+    __m256i offsets = _mm256_mullo_epi32(_mm256_set1_epi32(step), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+    __m256i fracmask = _mm256_set1_epi32(0xffff), one = _mm256_set1_epi32(16384);
+    const int *frames = (const int *)src;
+    size_t k = 0;
+    for (; k + 8 <= n; k += 8)
+    {
+        __m256i p = _mm256_add_epi32(_mm256_set1_epi32(pos), offsets);
+        pos += 8*step;
+        __m256i idx = _mm256_srli_epi32(p, 16);
+        __m256i a = _mm256_i32gather_epi32(frames, idx, 4);
+        __m256i b = _mm256_i32gather_epi32(frames + 1, idx, 4);
+        __m256i w = _mm256_srli_epi32(_mm256_and_si256(p, fracmask), 2);
+        w = _mm256_or_si256(_mm256_slli_epi32(w, 16), _mm256_sub_epi32(one, w));
+
+        // Per 128-bit lane: lo holds frames 0,1 | 4,5 and hi frames 2,3 | 6,7
+        __m256i lo = _mm256_srai_epi32(_mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), _mm256_unpacklo_epi32(w, w)), 14);
+        __m256i hi = _mm256_srai_epi32(_mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), _mm256_unpackhi_epi32(w, w)), 14);
+        lo = _mm256_srai_epi32(_mm256_mullo_epi32(lo, g), 14);
+        hi = _mm256_srai_epi32(_mm256_mullo_epi32(hi, g), 14);
+
+        int *out = acc + 2*k;
+        __m256i first = _mm256_permute2x128_si256(lo, hi, 0x20), second = _mm256_permute2x128_si256(lo, hi, 0x31);
+        _mm256_storeu_si256((__m256i *)out, _mm256_add_epi32(_mm256_loadu_si256((__m256i *)out), first));
+        _mm256_storeu_si256((__m256i *)(out + 8), _mm256_add_epi32(_mm256_loadu_si256((__m256i *)(out + 8)), second));
+    }
+    addresampled_scalar(acc + 2*k, src, pos, step, n - k, gain);
+}
+
+__attribute__((target("avx2")))
+static void clamp_avx2 (short *out, const int *acc, size_t n)
+{
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16)
+    {
+        __m256i a = _mm256_loadu_si256((const __m256i *)(acc + i)), b = _mm256_loadu_si256((const __m256i *)(acc + i + 8));
+        // packs works per lane; put the quarters back in order
+        __m256i s = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xd8);
+        _mm256_storeu_si256((__m256i *)(out + i), s);
+    }
+    clamp_scalar(out + i, acc + i, n - i);
+}
+
+static const MixKernels sse2 = { "sse2", add_sse2, addresampled_sse2, clamp_sse2 };
+static const MixKernels avx2 = { "avx2", add_avx2, addresampled_avx2, clamp_avx2 };
+
+#endif
+
+int mix_available (const MixKernels **sets, int max)
+{
+    int n = 0;
+    if (n < max) sets[n++] = &scalar;
+#ifdef MIX_X86
+    __builtin_cpu_init();
+    if (n < max && __builtin_cpu_supports("sse2")) sets[n++] = &sse2;
+    if (n < max && __builtin_cpu_supports("avx2")) sets[n++] = &avx2;
+#endif
+    return n;
+}
+
+const MixKernels &mix_kernels ()
+{
+    static const MixKernels *best = NULL;
+    if (!best)
+    {
+        const MixKernels *sets[3];
+        best = sets[mix_available(sets, 3) - 1];
+    }
+    return *best;
+}
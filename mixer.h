@@ -0,0 +1,40 @@
+#ifndef MIXER_H
+#define MIXER_H
+
+#include <stddef.h>
+
+/* The inner loops of the audio mixer, as plain C++, SSE2 and AVX2 kernel
+   sets. All three do the same integer arithmetic and give identical
+   output; mix_kernels() picks the best one the CPU supports.
+
+   Gains are Q14 fixed point, MIX_UNITY is 1.0 and they must stay below
+   2.0. Positions and steps through a sound are 16.16 fixed point frames;
+   the resampler interpolates linearly between neighbouring frames with
+   14-bit weights. */
+
+#define MIX_UNITY 16384
+#define MIX_STEP_ONE 65536
+
+struct MixKernels
+{
+    const char *name;
+
+    /* acc[i] += src[i] * gain >> 14 for n samples */
+    void (*add) (int *acc, const short *src, size_t n, int gain);
+
+    /* Add n stereo frames of src read at pos, pos + step, ... (pos relative
+       to src). Every frame read and the one after it must exist, and
+       pos % MIX_STEP_ONE + n * step must fit in 32 bits. */
+    void (*addresampled) (int *acc, const short *src, unsigned int pos, unsigned int step, size_t n, int gain);
+
+    /* out[i] = acc[i] saturated to 16 bits */
+    void (*clamp) (short *out, const int *acc, size_t n);
+};
+
+/* The fastest kernels this CPU runs */
+const MixKernels &mix_kernels ();
+
+/* Every kernel set this CPU runs, plain C++ first; returns how many */
+int mix_available (const MixKernels **sets, int max);
+
+#endif
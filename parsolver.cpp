@@ -0,0 +1,214 @@
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "solver.h"
+#include "statekey.h"
+
+using namespace std;
+
+/* Frontier states handed out per work item */
+#define WORK_CHUNK 256
+
+/* Reusable barrier for the level-synchronous steps */
+struct Barrier
+{
+    mutex m;
+    condition_variable cv;
+    int n, waiting;
+    unsigned int generation;
+
+    void wait ()
+    {
+        unique_lock<mutex> lock(m);
+        unsigned int gen = generation;
+        if (++waiting == n)
+        {
+            waiting = 0;
+            generation++;
+            cv.notify_all();
+        }
+        else cv.wait(lock, [&] { return generation != gen; });
+    }
+};
+
+/* A worker's share of the frontier: chunks [lo,hi) packed in one word, so the
+   owner (taking from hi) and thieves (taking from lo) both claim with one CAS */
+struct alignas(64) WorkRange
+{
+    atomic<unsigned long long> range;
+
+    void set (unsigned int lo, unsigned int hi) { range.store((unsigned long long)lo << 32 | hi); }
+
+    long pop ()
+    {
+        unsigned long long r = range.load();
+        for (;;)
+        {
+            unsigned int lo = r >> 32, hi = (unsigned int)r;
+            if (lo >= hi) return -1;
+            if (range.compare_exchange_weak(r, (unsigned long long)lo << 32 | (hi - 1))) return hi - 1;
+        }
+    }
+
+    long steal ()
+    {
+        unsigned long long r = range.load();
+        for (;;)
+        {
+            unsigned int lo = r >> 32, hi = (unsigned int)r;
+            if (lo >= hi) return -1;
+            if (range.compare_exchange_weak(r, (unsigned long long)(lo + 1) << 32 | hi)) return lo;
+        }
+    }
+};
+
+bool solver_parallel_bfs (const Level &level, Solution &sol, int nthreads)
+{
+    sol.moves = -1;
+    sol.path.clear();
+    sol.expanded = 0;
+    sol.visited = 0;
+
+    StateCodec codec = state_codec(level);
+    if (codec.nranks > MAX_BITSET_BITS)
+    {
+        fprintf(stderr, "State space too large for the parallel solver (%d groups on %dx%d)\n",
+                level.ngroups, level.rows, level.cols);
+        return false;
+    }
+    if (nthreads < 1) nthreads = 1;
+
+    // Visited set: one bit per state, claimed with an atomic fetch_or
+    size_t nwords = (codec.nranks + 63) / 64;
+    unique_ptr<atomic<unsigned long long>[]> visited(new atomic<unsigned long long>[nwords]());
+
+    vector<vector<unsigned long long> > layers(1);
+    State start = board_start(level);
+    unsigned long long s0 = codec.rank(start);
+    layers[0].push_back(s0);
+    visited[s0 / 64].fetch_or(1ULL << (s0 % 64));
+
+    vector<WorkRange> work(nthreads);
+    vector<vector<unsigned long long> > found(nthreads);
+    vector<size_t> expanded(nthreads, 0);
+    Barrier barrier;
+    barrier.n = nthreads;
+    barrier.waiting = 0;
+    barrier.generation = 0;
+
+    atomic<bool> goal(false);
+    bool done = false;
+    unsigned long long goalstate = 0;
+    char goalmove = 0;
+    mutex goallock;
+
+    // Split the frontier chunks evenly; stealing evens out the rest
+    auto distribute = [&] ()
+    {
+        size_t nchunks = (layers.back().size() + WORK_CHUNK - 1) / WORK_CHUNK;
+        for (int w=0; w<nthreads; w++)
+            work[w].set(nchunks * w / nthreads, nchunks * (w + 1) / nthreads);
+    };
+
+    auto worker = [&] (int self)
+    {
+        for (;;)
+        {
+            barrier.wait();  // frontier ready
+            if (done) return;
+            const vector<unsigned long long> &frontier = layers.back();
+
+            for (;;)
+            {
+                long c = work[self].pop();
+                for (int v = 1; c < 0 && v < nthreads; v++)
+                    c = work[(self + v) % nthreads].steal();
+                if (c < 0 || goal.load(memory_order_relaxed)) break;
+
+                size_t end = min(frontier.size(), (size_t)(c + 1) * WORK_CHUNK);
+                for (size_t f = (size_t)c * WORK_CHUNK; f < end; f++)
+                {
+                    State s = codec.unrank(frontier[f]);
+                    expanded[self]++;
+                    for (int m=0; m<NUM_MOVES; m++)
+                    {
+                        State t;
+                        int r = board_step(level, s, board_moves[m], t);
+                        if (r == MOVE_FALL) continue;
+                        if (r == MOVE_GOAL)
+                        {
+                            lock_guard<mutex> lock(goallock);
+                            if (!goal.load())
+                            {
+                                goalstate = frontier[f];
+                                goalmove = board_moves[m];
+                                goal.store(true);
+                            }
+                            continue;
+                        }
+                        unsigned long long idx = codec.rank(t);
+                        unsigned long long bit = 1ULL << (idx % 64);
+                        if (visited[idx / 64].load(memory_order_relaxed) & bit) continue;
+                        if (!(visited[idx / 64].fetch_or(bit, memory_order_relaxed) & bit))
+                            found[self].push_back(idx);
+                    }
+                }
+            }
+
+            barrier.wait();  // level finished
+            if (self == 0)
+            {
+                // Gather the next frontier while the others wait
+                layers.push_back(vector<unsigned long long>());
+                for (int w=0; w<nthreads; w++)
+                {
+                    layers.back().insert(layers.back().end(), found[w].begin(), found[w].end());
+                    found[w].clear();
+                }
+                done = goal.load() || layers.back().empty();
+                if (!done) distribute();
+            }
+        }
+    };
+
+    distribute();
+    vector<thread> threads;
+    for (int w=1; w<nthreads; w++) threads.push_back(thread(worker, w));
+    worker(0);
+    for (size_t w=0; w<threads.size(); w++) threads[w].join();
+
+    for (int w=0; w<nthreads; w++) sol.expanded += expanded[w];
+    for (size_t k=0; k<layers.size(); k++) sol.visited += layers[k].size();
+    if (!goal.load()) return true;
+
+    // The goal was reached from layer d: walk back through the layers for a path
+    size_t d = layers.size() - 2;
+    sol.path = goalmove;
+    State cur = codec.unrank(goalstate);
+    for (size_t k = d; k-- > 0; )
+    {
+        bool linked = false;
+        for (size_t f=0; f<layers[k].size() && !linked; f++)
+        {
+            State p = codec.unrank(layers[k][f]);
+            for (int m=0; m<NUM_MOVES && !linked; m++)
+            {
+                State t;
+                if (board_step(level, p, board_moves[m], t) == MOVE_OK && t == cur)
+                {
+                    sol.path += board_moves[m];
+                    cur = p;
+                    linked = true;
+                }
+            }
+        }
+    }
+    reverse(sol.path.begin(), sol.path.end());
+    sol.moves = sol.path.size();
+    return true;
+}
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "progcache.h"
+
+using namespace std;
+
+/* Where the binaries go, created on first use; empty if there is no home */
+static string cachedir ()
+{
+    string dir;
+    const char *xdg = getenv("XDG_CACHE_HOME"), *home = getenv("HOME");
+    if (xdg && *xdg) dir = xdg;
+    else if (home && *home) dir = string(home) + "/.cache";
+    else return "";
+    mkdir(dir.c_str(), 0755);
+    dir += "/tumblerz";
+    mkdir(dir.c_str(), 0755);
+    return dir;
+}
+
+static string entrypath (unsigned long long key)
+{
+    string dir = cachedir();
+    if (dir.empty()) return "";
+    char name[32];
+    snprintf(name, sizeof(name), "/%016llx.bin", key);
+    return dir + name;
+}
+
+/* FNV-1a over a string and its terminator, so "ab","c" and "a","bc" differ */
+static void addhash (unsigned long long &h, const char *s)
+{
+    if (!s) s = "";
+    do
+    {
+        h ^= (unsigned char)*s;
+        h *= 1099511628211ULL;
+    } while (*s++);
+}
+
+bool progcache_available ()
+{
+    if (!GLAD_GL_VERSION_4_1 && !GLAD_GL_ARB_get_program_binary) return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+unsigned long long progcache_key (const char *const *sources, int n)
+{
+    unsigned long long h = 14695981039346656037ULL;
+    addhash(h, (const char *)glGetString(GL_VENDOR));
+    addhash(h, (const char *)glGetString(GL_RENDERER));
+    addhash(h, (const char *)glGetString(GL_VERSION));
+    for (int k=0; k<n; k++) addhash(h, sources[k]);
+    return h;
+}
+
+/* Entries are "TZPB", the binary format and length as u32, then the binary */
+GLuint progcache_load (unsigned long long key)
+{
+    if (!progcache_available()) return 0;
+    string path = entrypath(key);
+    FILE *f = path.empty() ? NULL : fopen(path.c_str(), "rb");
+    if (!f) return 0;
+
+    // The length must account for the rest of the file, so a corrupt
+    // entry is dropped instead of allocating whatever it claims
+    char magic[4];
+    unsigned int format = 0, length = 0;
+    vector<char> binary;
+    struct stat st;
+    bool ok = fread(magic, 1, 4, f) == 4 && !memcmp(magic, "TZPB", 4) &&
+              fread(&format, sizeof(format), 1, f) == 1 && fread(&length, sizeof(length), 1, f) == 1 && length > 0 &&
+              fstat(fileno(f), &st) == 0 && (unsigned long long)st.st_size == 12 + (unsigned long long)length;
+    if (ok)
+    {
+        binary.resize(length);
+        ok = fread(&binary[0], 1, length, f) == length;
+    }
+    fclose(f);
+
+    GLuint program = 0;
+    if (ok)
+    {
+        program = glCreateProgram();
+        glProgramBinary(program, format, &binary[0], length);
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked)
+        {
+            glDeleteProgram(program);
+            program = 0;
+        }
+    }
+    if (!program)
+    {
+        fprintf(stderr, "Dropping unusable program cache entry %s\n", path.c_str());
+        remove(path.c_str());
+    }
+    return program;
+}
+
+void progcache_store (unsigned long long key, GLuint program)
+{
+    if (!progcache_available()) return;
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+    vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &length, &format, &binary[0]);
+    string path = entrypath(key);
+    if (length <= 0 || path.empty()) return;
+
+    // Write aside and rename, so a concurrent start never reads half a file
+    string tmp = path + "." + to_string(getpid());
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f) return;
+    unsigned int fmt = format, len = length;
+    bool ok = fwrite("TZPB", 1, 4, f) == 4 && fwrite(&fmt, sizeof(fmt), 1, f) == 1 &&
+              fwrite(&len, sizeof(len), 1, f) == 1 && fwrite(&binary[0], 1, len, f) == len;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp.c_str(), path.c_str()) != 0) remove(tmp.c_str());
+}
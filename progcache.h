@@ -0,0 +1,26 @@
+#ifndef PROGCACHE_H
+#define PROGCACHE_H
+
+#include <glad/glad.h>
+
+/* Linked GLSL programs saved with glGetProgramBinary() under
+   $XDG_CACHE_HOME/tumblerz (~/.cache/tumblerz by default), so later runs
+   skip compiling and linking. Entries are keyed by a hash of the GL vendor,
+   renderer and version strings and of the shader sources: a driver update
+   or an edited shader simply misses, and a binary the driver rejects is
+   deleted. */
+
+/* Whether the context can save and restore program binaries */
+bool progcache_available ();
+
+/* Key of a program built from n shader sources on the current context */
+unsigned long long progcache_key (const char *const *sources, int n);
+
+/* The cached program for key, or 0 if there is none that still links */
+GLuint progcache_load (unsigned long long key);
+
+/* Save a linked program; it must have been linked with
+   GL_PROGRAM_BINARY_RETRIEVABLE_HINT set */
+void progcache_store (unsigned long long key, GLuint program);
+
+#endif
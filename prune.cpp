@@ -0,0 +1,99 @@
+#include <limits.h>
+
+#include "prune.h"
+
+using namespace std;
+
+/* Cell (i,j) under transform t of a w x h box at (x0,y0) */
+static void transformcell (int x0, int y0, int w, int h, int t, int &i, int &j)
+{
+    int li = i - x0, lj = j - y0;
+    if (t & 1)
+    {
+        int k = li;
+        li = lj;
+        lj = k;
+    }
+    if (t & 2) li = w - 1 - li;
+    if (t & 4) lj = h - 1 - lj;
+    i = x0 + li;
+    j = y0 + lj;
+}
+
+void pruner_init (const Level &level, Pruner &p)
+{
+    int x1 = INT_MIN, y1 = INT_MIN;
+    p.x0 = INT_MAX;
+    p.y0 = INT_MAX;
+    for (size_t n=0; n<level.map.chunks.size(); n++)
+    {
+        const Chunk &c = level.map.chunks[n];
+        for (int k=0; k<CHUNK*CHUNK; k++)
+        {
+            if (c.tile[k] == TILE_VOID) continue;
+            int i = c.cx*CHUNK + k/CHUNK, j = c.cy*CHUNK + k%CHUNK;
+            if (i < p.x0) p.x0 = i;
+            if (j < p.y0) p.y0 = j;
+            if (i > x1) x1 = i;
+            if (j > y1) y1 = j;
+        }
+    }
+    if (x1 == INT_MIN) p.x0 = p.y0 = x1 = y1 = 0;
+    p.w = x1 - p.x0 + 1;
+    p.h = y1 - p.y0 + 1;
+
+    // A transform counts only if every tile lands on an identical one
+    p.symmetries.assign(1, 0);
+    for (int t=1; t<8; t++)
+    {
+        if ((t & 1) && p.w != p.h) continue;
+        bool same = true;
+        for (int i=p.x0; i<=x1 && same; i++)
+            for (int j=p.y0; j<=y1 && same; j++)
+            {
+                int ti = i, tj = j;
+                transformcell(p.x0, p.y0, p.w, p.h, t, ti, tj);
+                same = level.at(i, j) == level.at(ti, tj) && level.groupat(i, j) == level.groupat(ti, tj);
+            }
+        if (same) p.symmetries.push_back(t);
+    }
+
+    p.cols = level.cols;
+    p.seen.assign((size_t)level.rows * level.cols * 3, vector<unsigned int>());
+}
+
+State Pruner::transform (const State &s, int t) const
+{
+    int i1 = s.x, j1 = s.y;
+    int i2 = s.x + (s.orientation == ORIENT_LYING_X), j2 = s.y + (s.orientation == ORIENT_LYING_Y);
+    transformcell(x0, y0, w, h, t, i1, j1);
+    transformcell(x0, y0, w, h, t, i2, j2);
+
+    State r = s;
+    r.x = min(i1, i2);
+    r.y = min(j1, j2);
+    r.orientation = i1 != i2 ? ORIENT_LYING_X : j1 != j2 ? ORIENT_LYING_Y : ORIENT_STANDING;
+    return r;
+}
+
+bool Pruner::dominated (const State &s) const
+{
+    for (size_t k=0; k<symmetries.size(); k++)
+    {
+        State t = symmetries[k] ? transform(s, symmetries[k]) : s;
+        const vector<unsigned int> &masks = seen[((size_t)t.x*cols + t.y)*3 + t.orientation];
+        for (size_t m=0; m<masks.size(); m++)
+            if ((masks[m] & t.bridges) == t.bridges) return true;
+    }
+    return false;
+}
+
+void Pruner::insert (const State &s)
+{
+    vector<unsigned int> &masks = seen[((size_t)s.x*cols + s.y)*3 + s.orientation];
+    size_t keep = 0;
+    for (size_t m=0; m<masks.size(); m++)
+        if ((masks[m] & s.bridges) != masks[m]) masks[keep++] = masks[m];
+    masks.resize(keep);
+    masks.push_back(s.bridges);
+}
@@ -0,0 +1,39 @@
+#ifndef PRUNE_H
+#define PRUNE_H
+
+#include <vector>
+
+#include "board.h"
+
+/* State pruning for the searches.
+
+   Symmetry: a transform of the tiles' bounding box (mirror in x, mirror in
+   y, transpose on square boxes, and their combinations) that maps every
+   tile and group onto itself leaves the goal distance of a state unchanged,
+   so only one state of each symmetric family needs expanding.
+
+   Dominance: bridges only ever add support and a switch never turns off, so
+   a state is at least as close to the goal as any state on the same cell and
+   orientation with a subset of its bridges active. */
+
+struct Pruner
+{
+    int x0, y0, w, h;          // bounding box of the non-void tiles
+    std::vector<int> symmetries;   // transforms the board is invariant under, identity first
+    int cols;
+    std::vector<std::vector<unsigned int> > seen;  // per cell and orientation: maximal bridge sets kept
+
+    /* s under transform t: bit 0 transposes, bit 1 mirrors x, bit 2 mirrors y */
+    State transform (const State &s, int t) const;
+
+    /* Whether s, or a symmetric image of it, is no better than a kept state */
+    bool dominated (const State &s) const;
+
+    /* Keep s, forgetting the kept states it dominates */
+    void insert (const State &s);
+};
+
+/* Find the symmetries of a level and size the tables */
+void pruner_init (const Level &level, Pruner &p);
+
+#endif
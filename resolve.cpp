@@ -0,0 +1,179 @@
+#include <algorithm>
+
+#include "resolve.h"
+
+using namespace std;
+
+static long long cellkey (int x, int y)
+{
+    return (long long)x << 32 | (unsigned int)y;
+}
+
+static void addstate (StateGraph &g, ResolveCache &cache, const State &s)
+{
+    unsigned int n = g.states.size();
+    g.states.push_back(s);
+    g.next.insert(g.next.end(), NUM_MOVES, TRANS_FALL);
+    g.dist.push_back(-1);
+    cache.index[s] = n;
+    cache.preds.push_back(vector<unsigned int>());
+    cache.bycell[cellkey(s.x, s.y)].push_back(n);
+}
+
+void resolve_init (const LevelData &data, ResolveCache &cache)
+{
+    const StateGraph &g = data.graph;
+    cache.index.clear();
+    cache.bycell.clear();
+    cache.preds.assign(g.states.size(), vector<unsigned int>());
+    for (unsigned int s=0; s<g.states.size(); s++)
+    {
+        cache.index[g.states[s]] = s;
+        cache.bycell[cellkey(g.states[s].x, g.states[s].y)].push_back(s);
+        for (int m=0; m<NUM_MOVES; m++)
+        {
+            unsigned int t = g.next[s*NUM_MOVES + m];
+            if (t < g.states.size()) cache.preds[t].push_back(s);
+        }
+    }
+}
+
+/* One more than the closest successor's distance, -1 if none leads to the goal */
+static int bestdist (const StateGraph &g, unsigned int s)
+{
+    int best = -1;
+    for (int m=0; m<NUM_MOVES; m++)
+    {
+        unsigned int t = g.next[s*NUM_MOVES + m];
+        if (t == TRANS_GOAL) return 1;
+        if (t != TRANS_FALL && g.dist[t] >= 0 && (best < 0 || g.dist[t] + 1 < best)) best = g.dist[t] + 1;
+    }
+    return best;
+}
+
+/* Whether s still has a move along a shortest path of its current length */
+static bool supported (const StateGraph &g, unsigned int s)
+{
+    for (int m=0; m<NUM_MOVES; m++)
+    {
+        unsigned int t = g.next[s*NUM_MOVES + m];
+        if (t == TRANS_GOAL ? g.dist[s] == 1 : t != TRANS_FALL && g.dist[t] >= 0 && g.dist[t] == g.dist[s] - 1)
+            return true;
+    }
+    return false;
+}
+
+size_t resolve_update (LevelData &data, ResolveCache &cache, const vector<pair<int,int> > &cells)
+{
+    const Level &lv = data.level;
+    StateGraph &g = data.graph;
+    unordered_map<unsigned int, int> before;   // distances of the states touched, before the change
+
+    // States whose moves may land on a changed cell
+    vector<unsigned int> work;
+    vector<unsigned char> queued(g.states.size(), 0);
+    for (size_t c=0; c<cells.size(); c++)
+        for (int dx=-2; dx<=2; dx++)
+            for (int dy=-2; dy<=2; dy++)
+            {
+                unordered_map<long long, vector<unsigned int> >::const_iterator b =
+                    cache.bycell.find(cellkey(cells[c].first + dx, cells[c].second + dy));
+                if (b == cache.bycell.end()) continue;
+                for (size_t k=0; k<b->second.size(); k++)
+                    if (!queued[b->second[k]])
+                    {
+                        queued[b->second[k]] = 1;
+                        work.push_back(b->second[k]);
+                    }
+            }
+
+    // Recompute their transitions, exploring any state that is new
+    vector<unsigned int> changed;
+    for (size_t w=0; w<work.size(); w++)
+    {
+        unsigned int s = work[w];
+        unsigned int next[NUM_MOVES];
+        bool live = board_live(lv, g.states[s]);
+        for (int m=0; m<NUM_MOVES; m++)
+        {
+            next[m] = TRANS_FALL;
+            State t;
+            int r = live ? board_step(lv, g.states[s], board_moves[m], t) : MOVE_FALL;
+            if (r == MOVE_GOAL) next[m] = TRANS_GOAL;
+            if (r != MOVE_OK) continue;
+
+            unordered_map<State, unsigned int, StateHash>::iterator it = cache.index.find(t);
+            if (it == cache.index.end())
+            {
+                addstate(g, cache, t);
+                queued.push_back(1);
+                work.push_back(g.states.size() - 1);
+                next[m] = g.states.size() - 1;
+            }
+            else next[m] = it->second;
+        }
+
+        if (equal(next, next + NUM_MOVES, g.next.begin() + s*NUM_MOVES)) continue;
+        for (int m=0; m<NUM_MOVES; m++)
+        {
+            unsigned int old = g.next[s*NUM_MOVES + m];
+            if (old < g.states.size())
+            {
+                vector<unsigned int> &p = cache.preds[old];
+                p.erase(find(p.begin(), p.end(), s));
+            }
+            if (next[m] < g.states.size()) cache.preds[next[m]].push_back(s);
+            g.next[s*NUM_MOVES + m] = next[m];
+        }
+        changed.push_back(s);
+    }
+
+    // Invalidate states that lost their shortest path, and those that relied on them
+    vector<unsigned int> stack(changed), seeds(changed);
+    while (!stack.empty())
+    {
+        unsigned int s = stack.back();
+        stack.pop_back();
+        if (g.dist[s] < 0 || supported(g, s)) continue;
+
+        int old = g.dist[s];
+        if (!before.count(s)) before[s] = old;
+        g.dist[s] = -1;
+        seeds.push_back(s);
+        for (size_t k=0; k<cache.preds[s].size(); k++)
+            if (g.dist[cache.preds[s][k]] == old + 1) stack.push_back(cache.preds[s][k]);
+    }
+
+    // Relax the affected region in distance order
+    vector<vector<unsigned int> > buckets;
+    for (size_t k=0; k<seeds.size(); k++)
+    {
+        unsigned int s = seeds[k];
+        int d = bestdist(g, s);
+        if (d < 0 || (g.dist[s] >= 0 && g.dist[s] <= d)) continue;
+        if (!before.count(s)) before[s] = g.dist[s];
+        g.dist[s] = d;
+        if ((size_t)d >= buckets.size()) buckets.resize(d + 1);
+        buckets[d].push_back(s);
+    }
+    for (size_t d=1; d<buckets.size(); d++)
+        for (size_t k=0; k<buckets[d].size(); k++)
+        {
+            unsigned int s = buckets[d][k];
+            if (g.dist[s] != (int)d) continue;  // improved again since it was queued
+            for (size_t q=0; q<cache.preds[s].size(); q++)
+            {
+                unsigned int p = cache.preds[s][q];
+                if (g.dist[p] >= 0 && g.dist[p] <= (int)d + 1) continue;
+                if (!before.count(p)) before[p] = g.dist[p];
+                g.dist[p] = d + 1;
+                if (d + 1 >= buckets.size()) buckets.resize(d + 2);
+                buckets[d + 1].push_back(p);
+            }
+        }
+
+    size_t n = 0;
+    for (unordered_map<unsigned int, int>::iterator it = before.begin(); it != before.end(); ++it)
+        n += it->second != g.dist[it->first];
+    return n;
+}
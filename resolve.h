@@ -0,0 +1,37 @@
+#ifndef RESOLVE_H
+#define RESOLVE_H
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "levelpack.h"
+
+/* Incremental re-solve: after some tiles of a level change, repair its
+   StateGraph and goal distances instead of exploring and solving again.
+
+   Only states anchored within two cells of a change can have different
+   moves (a roll reaches at most two cells away). Their transitions are
+   recomputed, newly reachable states are explored from there, and the
+   distances are repaired in two passes: states that lost their shortest
+   path are invalidated back along their predecessors, then the affected
+   region is relaxed in distance order from a bucket queue.
+
+   States that the change cut off from the start stay in the graph; their
+   distances remain correct, they are just never visited. */
+
+struct ResolveCache
+{
+    std::unordered_map<State, unsigned int, StateHash> index;           // graph index of each state
+    std::vector<std::vector<unsigned int> > preds;                       // states with a move into each state
+    std::unordered_map<long long, std::vector<unsigned int> > bycell;   // states anchored on each cell
+};
+
+/* Index a level whose metadata is up to date */
+void resolve_init (const LevelData &data, ResolveCache &cache);
+
+/* Repair data.graph after the tiles at cells changed (board_prepare() must
+   have run). Returns the number of states whose distance changed. */
+size_t resolve_update (LevelData &data, ResolveCache &cache, const std::vector<std::pair<int,int> > &cells);
+
+#endif
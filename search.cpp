@@ -0,0 +1,281 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+#include "prune.h"
+#include "solver.h"
+
+using namespace std;
+
+/* Bidirectional search seeds the backward side with every bridge combination */
+#define BIDIR_MAX_GROUPS 16
+
+static vector<pair<int,int> > goal_cells (const Level &level)
+{
+    vector<pair<int,int> > goals;
+    for (size_t n=0; n<level.map.chunks.size(); n++)
+    {
+        const Chunk &c = level.map.chunks[n];
+        for (int k=0; k<CHUNK*CHUNK; k++)
+            if (c.tile[k] == TILE_GOAL)
+                goals.push_back(make_pair(c.cx*CHUNK + k/CHUNK, c.cy*CHUNK + k%CHUNK));
+    }
+    return goals;
+}
+
+/* Lower bound on the moves left. The block's centre moves 1.5 tiles when it
+   stands up or lies down and 1 tile when it rolls sideways, so the Manhattan
+   distance to the nearest goal in half tiles, divided by 3, never overestimates. */
+static int heuristic (const vector<pair<int,int> > &goals, const State &s)
+{
+    int cx = 2*s.x + (s.orientation == ORIENT_LYING_X);
+    int cy = 2*s.y + (s.orientation == ORIENT_LYING_Y);
+    int best = INT_MAX;
+    for (size_t g=0; g<goals.size(); g++)
+        best = min(best, abs(cx - 2*goals[g].first) + abs(cy - 2*goals[g].second));
+    return (best + 2) / 3;
+}
+
+void solver_astar (const Level &level, Solution &sol)
+{
+    // Search tree; a node with a goal move stands for the goal reached from it
+    struct Node
+    {
+        State s;
+        unsigned int parent;
+        int g;
+        char move;
+        bool goal;
+    };
+    vector<Node> nodes;
+    unordered_map<State, int, StateHash> best;  // cheapest g seen per state
+    vector<vector<unsigned int> > buckets;      // open nodes by f = g + h
+
+    sol.moves = -1;
+    sol.path.clear();
+    sol.expanded = 0;
+    sol.visited = 0;
+
+    vector<pair<int,int> > goals = goal_cells(level);
+    if (goals.empty()) return;
+
+    Node root = { board_start(level), 0, 0, 0, false };
+    nodes.push_back(root);
+    best[root.s] = 0;
+    buckets.resize(heuristic(goals, root.s) + 1);
+    buckets.back().push_back(0);
+
+    for (size_t f = 0; f < buckets.size(); f++)
+    {
+        // Within a bucket the newest (deepest) node goes first
+        while (!buckets[f].empty())
+        {
+            unsigned int n = buckets[f].back();
+            buckets[f].pop_back();
+            Node cur = nodes[n];
+
+            if (cur.goal)
+            {
+                for (unsigned int k = n; k != 0; k = nodes[k].parent) sol.path += nodes[k].move;
+                reverse(sol.path.begin(), sol.path.end());
+                sol.moves = sol.path.size();
+                sol.visited = best.size();
+                return;
+            }
+            if (cur.g > best[cur.s]) continue;  // a cheaper copy was queued later
+            sol.expanded++;
+
+            for (int m=0; m<NUM_MOVES; m++)
+            {
+                Node next = { cur.s, n, cur.g + 1, board_moves[m], false };
+                int r = board_step(level, cur.s, board_moves[m], next.s);
+                if (r == MOVE_FALL) continue;
+
+                int h = 0;
+                if (r == MOVE_GOAL) next.goal = true;
+                else
+                {
+                    unordered_map<State, int, StateHash>::iterator it = best.find(next.s);
+                    if (it != best.end() && it->second <= next.g) continue;
+                    best[next.s] = next.g;
+                    h = heuristic(goals, next.s);
+                }
+
+                size_t nf = next.g + h;
+                if (nf >= buckets.size()) buckets.resize(nf + 1);
+                buckets[nf].push_back(nodes.size());
+                nodes.push_back(next);
+            }
+        }
+    }
+    sol.visited = best.size();
+}
+
+bool solver_bidirectional (const Level &level, Solution &sol)
+{
+    // Forward: the parent and the move from it. Backward: the next state
+    // towards the goal and the move to it (dist 1 means the move ends the level).
+    struct Link
+    {
+        State other;
+        char move;
+        int dist;
+    };
+    typedef unordered_map<State, Link, StateHash> LinkMap;
+    LinkMap fwd, bwd;
+    vector<State> ffront, bfront, next;
+    vector<StateMove> preds;
+
+    sol.moves = -1;
+    sol.path.clear();
+    sol.expanded = 0;
+    sol.visited = 0;
+
+    if (level.ngroups > BIDIR_MAX_GROUPS)
+    {
+        fprintf(stderr, "Too many bridge groups (%d) for the bidirectional solver, the limit is %d\n",
+                level.ngroups, BIDIR_MAX_GROUPS);
+        return false;
+    }
+
+    State start = board_start(level);
+    Link root = { start, 0, 0 };
+    fwd[start] = root;
+    ffront.push_back(start);
+
+    board_goal_predecessors(level, preds);
+    for (size_t p=0; p<preds.size(); p++)
+    {
+        if (bwd.count(preds[p].from)) continue;
+        Link l = { preds[p].from, preds[p].move, 1 };
+        bwd[preds[p].from] = l;
+        bfront.push_back(preds[p].from);
+    }
+
+    int best = INT_MAX;
+    State meet = start;
+    if (bwd.count(start))
+    {
+        best = bwd[start].dist;
+        meet = start;
+    }
+
+    // Expand whole layers, smaller side first; the first layer that meets holds the optimum
+    for (int depth[2] = { 0, 1 }; best == INT_MAX && !ffront.empty() && !bfront.empty(); )
+    {
+        next.clear();
+        if (ffront.size() <= bfront.size())
+        {
+            for (size_t i=0; i<ffront.size(); i++)
+            {
+                sol.expanded++;
+                for (int m=0; m<NUM_MOVES; m++)
+                {
+                    State t;
+                    if (board_step(level, ffront[i], board_moves[m], t) != MOVE_OK || fwd.count(t)) continue;
+                    Link l = { ffront[i], board_moves[m], depth[0] + 1 };
+                    fwd[t] = l;
+                    next.push_back(t);
+
+                    LinkMap::iterator b = bwd.find(t);
+                    if (b != bwd.end() && l.dist + b->second.dist < best)
+                    {
+                        best = l.dist + b->second.dist;
+                        meet = t;
+                    }
+                }
+            }
+            ffront.swap(next);
+            depth[0]++;
+        }
+        else
+        {
+            for (size_t i=0; i<bfront.size(); i++)
+            {
+                sol.expanded++;
+                board_predecessors(level, bfront[i], preds);
+                for (size_t p=0; p<preds.size(); p++)
+                {
+                    if (bwd.count(preds[p].from)) continue;
+                    Link l = { bfront[i], preds[p].move, depth[1] + 1 };
+                    bwd[preds[p].from] = l;
+                    next.push_back(preds[p].from);
+
+                    LinkMap::iterator f = fwd.find(preds[p].from);
+                    if (f != fwd.end() && f->second.dist + l.dist < best)
+                    {
+                        best = f->second.dist + l.dist;
+                        meet = preds[p].from;
+                    }
+                }
+            }
+            bfront.swap(next);
+            depth[1]++;
+        }
+    }
+
+    sol.visited = fwd.size() + bwd.size();
+    if (best == INT_MAX) return true;
+
+    // Start to meeting point from the forward links, then on to the goal
+    for (State s = meet; !(s == start); s = fwd[s].other) sol.path += fwd[s].move;
+    reverse(sol.path.begin(), sol.path.end());
+    for (State s = meet; ; )
+    {
+        const Link &l = bwd[s];
+        sol.path += l.move;
+        if (l.dist == 1) break;
+        s = l.other;
+    }
+    sol.moves = sol.path.size();
+    return true;
+}
+
+void solver_pruned_bfs (const Level &level, Solution &sol, Pruner &prune)
+{
+    // Search tree of real states, so the path needs no transforms undone
+    struct Node
+    {
+        State s;
+        unsigned int parent;
+        char move;
+    };
+    vector<Node> nodes;
+
+    sol.moves = -1;
+    sol.path.clear();
+    sol.expanded = 0;
+
+    Node root = { board_start(level), 0, 0 };
+    nodes.push_back(root);
+    prune.insert(root.s);
+
+    // Breadth first, so anything kept earlier is no deeper than what it prunes
+    for (size_t head = 0; head < nodes.size(); head++)
+    {
+        sol.expanded++;
+        for (int m=0; m<NUM_MOVES; m++)
+        {
+            State t;
+            int r = board_step(level, nodes[head].s, board_moves[m], t);
+            if (r == MOVE_FALL) continue;
+            if (r == MOVE_GOAL)
+            {
+                sol.path = board_moves[m];
+                for (unsigned int n = head; n != 0; n = nodes[n].parent) sol.path += nodes[n].move;
+                reverse(sol.path.begin(), sol.path.end());
+                sol.moves = sol.path.size();
+                sol.visited = nodes.size();
+                return;
+            }
+            if (prune.dominated(t)) continue;
+            prune.insert(t);
+            Node n = { t, (unsigned int)head, board_moves[m] };
+            nodes.push_back(n);
+        }
+    }
+    sol.visited = nodes.size();
+}
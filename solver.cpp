@@ -0,0 +1,129 @@
+#include <unordered_map>
+#include <unordered_set>
+
+#include "solver.h"
+#include "statekey.h"
+
+using namespace std;
+
+void solver_bfs (const Level &level, Solution &sol)
+{
+    // Search tree: each node remembers how it was reached
+    struct Node
+    {
+        unsigned long long rank;
+        unsigned int parent;
+        char move;
+    };
+    vector<Node> nodes;
+
+    // Visited ranks: an exact-size bitset, or a hash set on huge state spaces
+    StateCodec codec = state_codec(level);
+    StateBitset seen;
+    unordered_set<unsigned long long> seenhash;
+    bool dense = codec.nranks <= MAX_BITSET_BITS;
+    if (dense) seen.resize(codec.nranks);
+
+    sol.moves = -1;
+    sol.path.clear();
+    sol.expanded = 0;
+
+    Node root = { codec.rank(board_start(level)), 0, 0 };
+    nodes.push_back(root);
+    if (dense) seen.insert(root.rank);
+    else seenhash.insert(root.rank);
+
+    for (size_t head = 0; head < nodes.size(); head++)
+    {
+        State s = codec.unrank(nodes[head].rank);
+        sol.expanded++;
+        for (int m=0; m<NUM_MOVES; m++)
+        {
+            State t;
+            int r = board_step(level, s, board_moves[m], t);
+            if (r == MOVE_FALL) continue;
+            if (r == MOVE_GOAL)
+            {
+                sol.path = board_moves[m];
+                for (unsigned int n = head; n != 0; n = nodes[n].parent) sol.path += nodes[n].move;
+                sol.path.assign(sol.path.rbegin(), sol.path.rend());
+                sol.moves = sol.path.size();
+                sol.visited = nodes.size();
+                return;
+            }
+            Node n = { codec.rank(t), (unsigned int)head, board_moves[m] };
+            if (!(dense ? seen.insert(n.rank) : seenhash.insert(n.rank).second)) continue;
+            nodes.push_back(n);
+        }
+    }
+    sol.visited = nodes.size();
+}
+
+void solver_explore (const Level &level, StateGraph &graph)
+{
+    unordered_map<State, unsigned int, StateHash> index;
+
+    graph.states.clear();
+    graph.next.clear();
+    graph.states.push_back(board_start(level));
+    index[graph.states[0]] = 0;
+
+    // Forward BFS; the state list doubles as the queue
+    for (size_t head = 0; head < graph.states.size(); head++)
+    {
+        State s = graph.states[head];
+        for (int m=0; m<NUM_MOVES; m++)
+        {
+            State t;
+            int r = board_step(level, s, board_moves[m], t);
+            if (r == MOVE_FALL) { graph.next.push_back(TRANS_FALL); continue; }
+            if (r == MOVE_GOAL) { graph.next.push_back(TRANS_GOAL); continue; }
+
+            auto it = index.find(t);
+            if (it == index.end())
+            {
+                it = index.emplace(t, (unsigned int)graph.states.size()).first;
+                graph.states.push_back(t);
+            }
+            graph.next.push_back(it->second);
+        }
+    }
+
+    solver_distances(graph);
+}
+
+void solver_distances (StateGraph &graph)
+{
+    size_t n = graph.states.size();
+
+    // Reverse the transition table into CSR form
+    vector<unsigned int> start(n + 1, 0), pred(graph.next.size());
+    for (size_t e=0; e<graph.next.size(); e++)
+        if (graph.next[e] < n) start[graph.next[e] + 1]++;
+    for (size_t i=0; i<n; i++) start[i+1] += start[i];
+    vector<unsigned int> fill(start.begin(), start.end() - 1);
+    for (size_t e=0; e<graph.next.size(); e++)
+        if (graph.next[e] < n) pred[fill[graph.next[e]]++] = e / NUM_MOVES;
+
+    graph.dist.assign(n, -1);
+    vector<unsigned int> queue;
+    for (size_t e=0; e<graph.next.size(); e++)
+    {
+        unsigned int s = e / NUM_MOVES;
+        if (graph.next[e] == TRANS_GOAL && graph.dist[s] < 0)
+        {
+            graph.dist[s] = 1;
+            queue.push_back(s);
+        }
+    }
+    for (size_t head = 0; head < queue.size(); head++)
+    {
+        unsigned int s = queue[head];
+        for (unsigned int p = start[s]; p < start[s+1]; p++)
+            if (graph.dist[pred[p]] < 0)
+            {
+                graph.dist[pred[p]] = graph.dist[s] + 1;
+                queue.push_back(pred[p]);
+            }
+    }
+}
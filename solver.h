@@ -0,0 +1,66 @@
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <string>
+#include <vector>
+
+#include "board.h"
+#include "prune.h"
+
+/* Special successors in StateGraph::next */
+#define TRANS_FALL 0xFFFFFFFFu
+#define TRANS_GOAL 0xFFFFFFFEu
+
+/* Every state reachable from the start, with its transitions and distances */
+struct StateGraph
+{
+    std::vector<State> states;       // states[0] is the start state
+    std::vector<unsigned int> next;  // NUM_MOVES successors per state (index or TRANS_*)
+    std::vector<int> dist;           // moves left to the goal, -1 if it cannot be reached
+};
+
+/* Result of a search */
+struct Solution
+{
+    int moves;            // optimal move count, -1 if the goal cannot be reached
+    std::string path;     // the moves, as board_moves letters
+    size_t expanded;      // states taken off the frontier
+    size_t visited;       // distinct states seen
+};
+
+/* Breadth-first search from the start state to the goal */
+void solver_bfs (const Level &level, Solution &sol);
+
+/* Level-synchronous BFS on nthreads workers that steal frontier chunks from
+   each other and share an atomic visited bitset. Finds the same optimal move
+   count as solver_bfs(); returns false if the bitset would be too large. */
+bool solver_parallel_bfs (const Level &level, Solution &sol, int nthreads);
+
+/* A* on a bucket queue, guided by a consistent lower bound from the block's
+   centre to the nearest goal. Same optimal move count as solver_bfs(). */
+void solver_astar (const Level &level, Solution &sol);
+
+/* Breadth-first from the start and backwards from the goal, one layer at a
+   time on the smaller frontier. Returns false if the level has too many
+   bridge groups to seed the backward search. */
+bool solver_bidirectional (const Level &level, Solution &sol);
+
+/* Breadth-first search that skips states symmetric to, or dominated by, a
+   state already kept (see prune.h). Same optimal move count as solver_bfs().
+   prune comes from pruner_init() on level and is filled by the search, so a
+   caller can report its symmetries without detecting them twice. */
+void solver_pruned_bfs (const Level &level, Solution &sol, Pruner &prune);
+
+/* Disk-backed BFS for state spaces larger than memory. Each layer is a
+   sorted file of state ranks under a fresh directory in tmpdir. Successors
+   are buffered up to memory bytes, sorted into runs, and merged against the
+   visited file to drop duplicates. Returns false on an I/O error. */
+bool solver_external_bfs (const Level &level, Solution &sol, const char *tmpdir, size_t memory);
+
+/* Enumerate the reachable states of a level and the goal distance of each */
+void solver_explore (const Level &level, StateGraph &graph);
+
+/* Fill graph.dist from graph.next with a backward BFS from the goal */
+void solver_distances (StateGraph &graph);
+
+#endif
@@ -0,0 +1,48 @@
+#include <stdio.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "startup.h"
+
+using namespace std;
+
+struct Phase
+{
+    const char *name;
+    double ms;
+};
+
+static chrono::steady_clock::time_point last = chrono::steady_clock::now();
+static vector<Phase> phases;
+
+void startup_mark (const char *name)
+{
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    Phase p = { name, chrono::duration<double, milli>(now - last).count() };
+    phases.push_back(p);
+    last = now;
+}
+
+bool startup_report (const char *format)
+{
+    bool json = !strcmp(format, "json");
+    if (!json && strcmp(format, "csv"))
+    {
+        fprintf(stderr, "Unknown format '%s' (use csv or json)\n", format);
+        return false;
+    }
+
+    double total = 0;
+    if (json) printf("{\"phases\": [\n");
+    else printf("phase,ms\n");
+    for (size_t k=0; k<phases.size(); k++)
+    {
+        total += phases[k].ms;
+        if (json) printf("  {\"name\": \"%s\", \"ms\": %.3f}%s\n", phases[k].name, phases[k].ms, k+1 < phases.size() ? "," : "");
+        else printf("%s,%.3f\n", phases[k].name, phases[k].ms);
+    }
+    if (json) printf("], \"total_ms\": %.3f}\n", total);
+    else printf("total,%.3f\n", total);
+    return true;
+}
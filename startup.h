@@ -0,0 +1,16 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+/* Wall-clock timing of the steps between process start and the first frame
+   on screen, for --startup-report. Each mark closes a phase that began at
+   the previous mark, or at static initialisation for the first one, so the
+   phases add up to the whole cold start. */
+
+/* End the running phase and record it under name (a literal) */
+void startup_mark (const char *name);
+
+/* Print the phases and their total to stdout as "csv" or "json"; false
+   with a message for any other format */
+bool startup_report (const char *format);
+
+#endif
@@ -0,0 +1,23 @@
+#include "statekey.h"
+
+StateCodec state_codec (const Level &level)
+{
+    StateCodec c;
+    c.cols = level.cols;
+    c.ngroups = level.ngroups;
+    c.nranks = ((unsigned long long)level.rows * level.cols * 3) << c.ngroups;
+    return c;
+}
+
+State StateCodec::unrank (unsigned long long r) const
+{
+    State s;
+    s.bridges = r & ((1ULL << ngroups) - 1);
+    r >>= ngroups;
+    s.orientation = r % 3;
+    r /= 3;
+    s.x = r / cols;
+    s.y = r % cols;
+    s.fallen = 0;
+    return s;
+}
@@ -0,0 +1,53 @@
+#ifndef STATEKEY_H
+#define STATEKEY_H
+
+#include <vector>
+
+#include "board.h"
+
+/* Compact form of a State for the searches.
+
+   A rank numbers the states the block can rest in densely from 0: cell,
+   then orientation, then the bridge bits. A resting block never has a
+   fallen tile (board_step() only sets one in the fatal result), so the
+   fallen bits are left out and nranks stays rows*cols*3 << ngroups. */
+
+/* Largest visited bitset a search will allocate, in bits (2 GB) */
+#define MAX_BITSET_BITS (1ULL << 34)
+
+struct StateCodec
+{
+    int cols;
+    int ngroups;
+    unsigned long long nranks;    // rank() is below this
+
+    unsigned long long rank (const State &s) const
+    {
+        return ((unsigned long long)(s.x*cols + s.y)*3 + s.orientation) << ngroups | s.bridges;
+    }
+
+    State unrank (unsigned long long r) const;
+};
+
+StateCodec state_codec (const Level &level);
+
+/* One bit per rank, sized exactly to the state space */
+struct StateBitset
+{
+    std::vector<unsigned long long> words;
+
+    void resize (unsigned long long nbits) { words.assign((nbits + 63) / 64, 0); }
+
+    bool test (unsigned long long r) const { return words[r / 64] >> (r % 64) & 1; }
+
+    /* Set bit r; returns true if it was clear */
+    bool insert (unsigned long long r)
+    {
+        unsigned long long bit = 1ULL << (r % 64);
+        if (words[r / 64] & bit) return false;
+        words[r / 64] |= bit;
+        return true;
+    }
+};
+
+#endif
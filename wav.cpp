@@ -0,0 +1,127 @@
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "wav.h"
+
+static unsigned int le16 (const unsigned char *p) { return p[0] | p[1] << 8; }
+static unsigned int le32 (const unsigned char *p) { return p[0] | p[1] << 8 | p[2] << 16 | (unsigned int)p[3] << 24; }
+
+bool wav_open (const char *path, WavFile &wav)
+{
+    memset(&wav, 0, sizeof(wav));
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0)
+    {
+        fprintf(stderr, "Cannot open sound %s\n", path);
+        if (fd >= 0) close(fd);
+        return false;
+    }
+    wav.size = st.st_size;
+    wav.map = wav.size ? mmap(NULL, wav.size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (wav.map == MAP_FAILED)
+    {
+        fprintf(stderr, "Cannot map sound %s\n", path);
+        wav.map = NULL;
+        return false;
+    }
+
+    const unsigned char *file = (const unsigned char *)wav.map;
+    if (wav.size < 12 || memcmp(file, "RIFF", 4) || memcmp(file + 8, "WAVE", 4))
+    {
+        fprintf(stderr, "%s is not a WAV file\n", path);
+        wav_close(wav);
+        return false;
+    }
+
+    // Walk the chunks for the format and the samples
+    size_t datasize = 0;
+    for (size_t p = 12; p + 8 <= wav.size; )
+    {
+        size_t size = le32(file + p + 4);
+        if (size > wav.size - p - 8) size = wav.size - p - 8;
+        if (!memcmp(file + p, "fmt ", 4) && size >= 16)
+        {
+            wav.format = le16(file + p + 8);
+            wav.channels = le16(file + p + 10);
+            wav.rate = le32(file + p + 12);
+            wav.bits = le16(file + p + 22);
+            if (wav.format == 0xfffe && size >= 26) wav.format = le16(file + p + 32);   // WAVE_FORMAT_EXTENSIBLE
+        }
+        else if (!memcmp(file + p, "data", 4))
+        {
+            wav.data = file + p + 8;
+            datasize = size;
+        }
+        p += 8 + size + (size & 1);
+    }
+
+    bool pcm = wav.format == WAV_PCM && (wav.bits == 8 || wav.bits == 16 || wav.bits == 24 || wav.bits == 32);
+    bool flt = wav.format == WAV_FLOAT && wav.bits == 32;
+    if (!(pcm || flt) || (wav.channels != 1 && wav.channels != 2) || !wav.rate || !wav.data)
+    {
+        fprintf(stderr, "%s: unsupported WAV format\n", path);
+        wav_close(wav);
+        return false;
+    }
+    wav.frames = datasize / (wav.channels * wav.bits / 8);
+    return true;
+}
+
+void wav_close (WavFile &wav)
+{
+    if (wav.map) munmap(wav.map, wav.size);
+    wav.map = NULL;
+}
+
+bool wav_native (const WavFile &wav, unsigned int rate, int channels)
+{
+    return __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ && wav.format == WAV_PCM && wav.bits == 16 &&
+           wav.rate == rate && wav.channels == channels && (uintptr_t)wav.data % 2 == 0;
+}
+
+/* Sample k of the file as a float in [-1, 1] */
+static float sample (const WavFile &wav, size_t k)
+{
+    const unsigned char *p = wav.data + k * (wav.bits / 8);
+    if (wav.format == WAV_FLOAT)
+    {
+        float f;
+        unsigned int u = le32(p);
+        memcpy(&f, &u, sizeof(f));
+        return f;
+    }
+    switch (wav.bits)
+    {
+        case 8: return (p[0] - 128) / 128.0f;
+        case 16: return (short)le16(p) / 32768.0f;
+        case 24: return (int)(p[0] << 8 | p[1] << 16 | (unsigned int)p[2] << 24) / 2147483648.0f;
+        default: return (int)le32(p) / 2147483648.0f;
+    }
+}
+
+/* Frame i with the channels mapped to the output */
+static float channel (const WavFile &wav, size_t i, int c, int channels)
+{
+    if (wav.channels == channels) return sample(wav, i*wav.channels + c);
+    if (wav.channels == 1) return sample(wav, i);
+    return (sample(wav, 2*i) + sample(wav, 2*i + 1)) * 0.5f;
+}
+
+void wav_convert (const WavFile &wav, int channels, short *out)
+{
+    for (size_t i=0; i<wav.frames; i++)
+    {
+        for (int c=0; c<channels; c++)
+        {
+            int s = (int)(channel(wav, i, c, channels) * 32768.0f);
+            out[i*channels + c] = s > 32767 ? 32767 : s < -32768 ? -32768 : s;
+        }
+    }
+}
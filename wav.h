@@ -0,0 +1,37 @@
+#ifndef WAV_H
+#define WAV_H
+
+#include <stddef.h>
+
+/* A WAV file mapped read-only into memory. Parsing only locates the format
+   and the sample data inside the mapping, nothing is copied. */
+struct WavFile
+{
+    void *map;
+    size_t size;
+    int format;                    // WAV_PCM or WAV_FLOAT
+    int channels, bits;
+    unsigned int rate;
+    const unsigned char *data;     // first sample, inside the mapping
+    size_t frames;
+};
+
+#define WAV_PCM 1
+#define WAV_FLOAT 3
+
+/* Map and parse path; false with a message on stderr if it is not a WAV
+   file this can play (PCM 8/16/24/32-bit or 32-bit float, 1 or 2 channels) */
+bool wav_open (const char *path, WavFile &wav);
+
+void wav_close (WavFile &wav);
+
+/* Whether the samples are already interleaved 16-bit at the given rate and
+   channel count, so they can be played straight from the mapping */
+bool wav_native (const WavFile &wav, unsigned int rate, int channels);
+
+/* Convert to interleaved 16-bit with channels, into out (wav.frames frames).
+   Mono is duplicated to stereo and stereo is averaged to mono; the rate
+   stays the file's, the mixer's resampler changes it. */
+void wav_convert (const WavFile &wav, int channels, short *out);
+
+#endif